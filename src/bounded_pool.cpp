@@ -0,0 +1,65 @@
+#include "bounded_pool.h"
+#include <algorithm>
+#include <utility>
+
+BoundedPool::BoundedPool(const std::size_t thread_count, const std::size_t max_queued)
+    : max_in_flight(std::max<std::size_t>(thread_count, 1) + max_queued) {
+  workers.reserve(std::max<std::size_t>(thread_count, 1));
+  for (std::size_t i = 0; i < std::max<std::size_t>(thread_count, 1); i++)
+    workers.emplace_back([this](const std::stop_token &stop) { run(stop); });
+}
+
+BoundedPool::admission BoundedPool::try_admit() {
+  std::lock_guard lock{mutex};
+  if (in_flight >= max_in_flight)
+    return admission{nullptr};
+  in_flight++;
+  return admission{this};
+}
+
+void BoundedPool::release() {
+  std::lock_guard lock{mutex};
+  in_flight--;
+}
+
+std::size_t BoundedPool::in_flight_jobs() const {
+  std::lock_guard lock{mutex};
+  return in_flight;
+}
+
+void BoundedPool::enqueue(const std::coroutine_handle<> handle) {
+  {
+    std::lock_guard lock{mutex};
+    queue.push_back(handle);
+  }
+  wake.notify_one();
+}
+
+void BoundedPool::run(const std::stop_token &stop) {
+  while (true) {
+    std::coroutine_handle<> handle;
+    {
+      std::unique_lock lock{mutex};
+      if (!wake.wait(lock, stop, [this] { return !queue.empty(); }))
+        return;
+      handle = queue.front();
+      queue.pop_front();
+    }
+    handle.resume();
+  }
+}
+
+BoundedPool::admission::admission(BoundedPool *pool) : pool(pool) {
+}
+
+BoundedPool::admission::admission(admission &&other) noexcept : pool(std::exchange(other.pool, nullptr)) {
+}
+
+BoundedPool::admission::~admission() {
+  if (pool != nullptr)
+    pool->release();
+}
+
+BoundedPool::admission::operator bool() const {
+  return pool != nullptr;
+}
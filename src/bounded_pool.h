@@ -0,0 +1,76 @@
+#pragma once
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that coroutines can hop onto with `co_await pool.schedule()`.
+// Keeps slow, blocking work (downloads, shelling out to rusty-sussy) off DPP's event and REST threads,
+// and since the thread count is fixed, a burst of heavy commands queues up instead of piling on.
+// How many are let in at all is counted separately, by `try_admit`
+class BoundedPool {
+  mutable std::mutex mutex;
+  std::condition_variable_any wake;
+  std::deque<std::coroutine_handle<>> queue;
+  // Running, queued, or off waiting on Discord between hops
+  std::size_t in_flight{0};
+  std::size_t max_in_flight;
+  std::vector<std::jthread> workers;
+
+  void enqueue(std::coroutine_handle<> handle);
+  void release();
+  void run(const std::stop_token &stop);
+
+public:
+  // Held by a heavy command from when it's let in until its handler is done,
+  // so a command waiting on a download between two hops still counts
+  class admission {
+    BoundedPool *pool;
+
+  public:
+    explicit admission(BoundedPool *pool);
+    admission(admission &&other) noexcept;
+    admission(const admission &) = delete;
+    admission &operator=(const admission &) = delete;
+    admission &operator=(admission &&) = delete;
+    ~admission();
+
+    // False if the command was turned away
+    explicit operator bool() const;
+  };
+
+  struct schedule_awaiter {
+    BoundedPool &pool;
+
+    [[nodiscard]] bool await_ready() const noexcept {
+      return false;
+    }
+
+    void await_suspend(const std::coroutine_handle<> handle) {
+      pool.enqueue(handle);
+    }
+
+    void await_resume() const noexcept {
+    }
+  };
+
+  // Lets in up to `thread_count + max_queued` heavy commands at once
+  BoundedPool(std::size_t thread_count, std::size_t max_queued);
+
+  BoundedPool(const BoundedPool &) = delete;
+  BoundedPool &operator=(const BoundedPool &) = delete;
+
+  // An empty admission if too many heavy commands are already in flight
+  [[nodiscard]] admission try_admit();
+
+  [[nodiscard]] std::size_t in_flight_jobs() const;
+
+  // Resumes on a pool thread, however long the queue is. Only admitted commands should be hopping on
+  schedule_awaiter schedule() {
+    return {*this};
+  }
+};
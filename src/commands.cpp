@@ -0,0 +1,383 @@
+#include "commands.h"
+#include "project.h"
+#include "teams.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <fstream>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string>
+#include <variant>
+
+namespace {
+// ----- Handlers -----
+dpp::task<void> bone_about(const dpp::slashcommand_t &, const Responder &responder, bot_context &) {
+  spdlog::info("Sending `bone-about`");
+  responder.respond(fmt::format(R"(Bone Bot v{}
+Code by: <@277914802071011328>
+Art by: <@551533880432263201>
+Contribute to the problem @ <https://github.com/The-Dogghouse/bone-bot>
+Our versioning scheme <https://0ver.org/>)", // Links are in <> to supress the embed
+      BONE_BOT_VERSION));
+  co_return;
+}
+
+dpp::task<void> bone_sailor(const dpp::slashcommand_t &event, const Responder &responder, bot_context &context) {
+  const auto author_mention = event.command.member.get_mention();
+  const auto insult = fmt::format("{}. {}.", author_mention, context.insults.insult(event.command.channel_id));
+  spdlog::info("Sending insult {}", insult);
+  responder.respond(insult);
+  co_return;
+}
+
+dpp::task<void> bone_sus(const dpp::slashcommand_t &event, const Responder &responder, bot_context &context) {
+  const auto attachment = event.command.get_resolved_attachment(std::get<dpp::snowflake>(event.get_parameter("file")));
+  if (!attachment.content_type.starts_with("image")) { // Only took 35 years baby!
+    responder.respond("I need an image you sussy baka!");
+    co_return;
+  }
+
+  // Width is an optional param
+  const auto width_param = event.get_parameter("width");
+  int64_t width{21};
+  if (std::holds_alternative<int64_t>(width_param))
+    width = std::get<int64_t>(width_param);
+
+  // Held until the response goes out, so requests still downloading or waiting on the pool count as load too
+  auto render_job = context.sus_load.begin(width);
+  if (render_job.clamped)
+    spdlog::info("Sus is busy, clamping width {} to {}", width, render_job.width);
+
+  const auto response = co_await context.discord.co_download(attachment.url);
+
+  if (response.status != 200) {
+    responder.respond("Error, could not download attachment");
+    co_return;
+  }
+
+  // The download finishes on DPP's REST thread, get off it before rendering
+  co_await context.heavy_pool.schedule();
+
+  // Add unix timestamp to the filename, so you can't overwrite something with the same name
+  // if you managed to get two things up in the same second with the same name,
+  // then let me be the first to welcome you here
+  const auto current_unix_timestamp =
+      std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  const auto download_filename = std::to_string(current_unix_timestamp) + "-" + attachment.filename;
+
+  const auto out_path = context.sus_input_images_path / download_filename;
+  std::fstream test_out{out_path, std::ios::out | std::ios::binary};
+  test_out.write(response.body.c_str(), response.body.size());
+  test_out.close();
+
+  const auto result_path = context.sus_output_images_path / (std::to_string(current_unix_timestamp) + ".gif");
+
+  const auto sus_command = fmt::format("{} --input={} --output={} --width={}", context.sus_binary.string(),
+      out_path.string(), result_path.string(), render_job.width);
+  spdlog::info("sus command {}", sus_command);
+  const auto sus_status = std::system(sus_command.c_str());
+  if (sus_status != 0 || !std::filesystem::exists(result_path)) {
+    spdlog::error("Sus command failed with status {}", sus_status);
+    responder.respond("Error, could not sussify the image");
+    co_return;
+  }
+  render_job.completed();
+
+  dpp::message result{event.command.channel_id, ""};
+  if (render_job.clamped)
+    result.set_content(fmt::format(
+        "Lots of sus going on right now, so you get {} crew-mates per row instead of {}", render_job.width, width));
+  result.add_file(fmt::format("sussified-{}.gif", current_unix_timestamp), dpp::utility::read_file(result_path));
+
+  responder.respond(result);
+}
+
+dpp::task<void> bone_teams(const dpp::slashcommand_t &event, const Responder &responder, bot_context &context) {
+  spdlog::info("Received 'bone-team'");
+
+  const auto &cmd_data = event.command.get_command_interaction();
+  const auto &subcommand = cmd_data.options[0];
+
+  std::optional<int> team_count;
+  if (const auto count_param = event.get_parameter("team-count"); std::holds_alternative<int64_t>(count_param)) {
+    team_count = static_cast<int>(std::get<int64_t>(count_param));
+  }
+
+  std::optional<int> team_size;
+  if (const auto size_param = event.get_parameter("team-size"); std::holds_alternative<int64_t>(size_param)) {
+    team_size = static_cast<int>(std::get<int64_t>(size_param));
+  }
+
+  const auto captains = co_await get_captains_for_command(event, context.discord);
+
+  const TeamHistory *diverse_history{nullptr};
+  if (const auto diverse_param = event.get_parameter("diverse");
+      std::holds_alternative<bool>(diverse_param) && std::get<bool>(diverse_param))
+    diverse_history = &context.team_history;
+
+  if (subcommand.name == "channel") {
+    const auto channel_id = std::get<dpp::snowflake>(event.get_parameter("channel"));
+    auto channel = co_await context.discord.co_channel_get(channel_id);
+
+    if (channel.is_error()) {
+      responder.respond("Failed to get channel members");
+      co_return;
+    }
+
+    const auto members = channel.get<dpp::channel>().get_voice_members();
+    if (members.empty()) {
+      responder.respond("Requested channel has no voice members");
+      co_return;
+    }
+
+    std::vector<dpp::guild_member> result;
+    result.reserve(members.size());
+    for (const auto &[snowflake, _] : members)
+      result.push_back(dpp::find_guild_member(event.command.guild_id, snowflake));
+
+    const auto teams = make_teams(result, team_count, team_size, captains, diverse_history);
+    record_teams(teams, context.team_history);
+    const auto formatted_teams =
+        format_teams(teams, [&context, &event]() { return context.insults.team_name(event.command.channel_id); });
+
+    const auto voice_targets = get_voice_targets_for_command(event);
+    if (voice_targets.empty()) {
+      responder.respond(formatted_teams);
+      co_return;
+    }
+
+    // The bot does the moving, so make sure whoever asked could have done it themselves
+    if (!can_move_members(event, channel_id, voice_targets)) {
+      responder.respond(
+          formatted_teams + "\nYou need the 'Move Members' permission in those channels to move teams");
+      co_return;
+    }
+
+    responder.respond(formatted_teams);
+    co_await move_teams_to_channels(
+        event, context.discord, responder, teams, voice_targets, channel_id, formatted_teams);
+    co_return;
+  }
+
+  if (subcommand.name == "event") {
+    spdlog::info("Getting event info for guild: {}", event.command.guild_id.str());
+
+    const auto event_url = std::get<std::string>(event.get_parameter("event-url"));
+
+    unsigned long long parsed_event_id;
+    if (event_url.find("discord.gg") != std::string::npos) {
+      parsed_event_id = std::stoull(event_url.substr(event_url.find_last_of("event=") + 1));
+    } else /* discord.com event link */ {
+      parsed_event_id = std::stoull(event_url.substr(event_url.find_last_of('/') + 1));
+    }
+
+    spdlog::info("parsed_event_id: {}", parsed_event_id);
+    const dpp::snowflake event_snowflake{parsed_event_id};
+
+    auto command_event = co_await context.discord.co_guild_event_get(event.command.guild_id, event_snowflake);
+    if (command_event.is_error()) {
+      responder.respond("Failed to get event");
+      co_return;
+    }
+
+    const auto event_users =
+        co_await context.discord.co_guild_event_users_get(event.command.guild_id, event_snowflake);
+    if (event_users.is_error()) {
+      responder.respond("Failed to get event members");
+      co_return;
+    }
+
+    const auto &event_member_map = event_users.get<dpp::event_member_map>();
+    if (event_member_map.empty()) {
+      responder.respond("Requested event has no 'interested' members");
+      co_return;
+    }
+
+    std::vector<dpp::guild_member> members;
+    members.reserve(event_member_map.size());
+    for (const auto &[_, event_member] : event_member_map) {
+      members.emplace_back(event_member.member);
+    }
+
+    const auto teams = make_teams(members, team_count, team_size, {}, diverse_history);
+    record_teams(teams, context.team_history);
+    const auto formatted_teams =
+        format_teams(teams, [&context, &event]() { return context.insults.team_name(event.command.channel_id); });
+    responder.respond(formatted_teams);
+  }
+}
+
+// ----- Options -----
+// Document required parameters,
+// rather than just having a 'true'
+constexpr auto required_param{true};
+
+template <std::size_t... sizes>
+constexpr auto join_options(const std::array<option_spec, sizes> &...lists) {
+  std::array<option_spec, (sizes + ...)> joined{};
+  auto out = joined.begin();
+  ((out = std::copy(lists.begin(), lists.end(), out)), ...);
+  return joined;
+}
+
+// clang-format off
+constexpr std::array sus_options{
+    option_spec{dpp::co_attachment, "file", "Select an image", required_param},
+    option_spec{dpp::co_integer, "width", "Number of crew-mates per row", false, 1, 255},
+};
+
+// Shared by both `bone-teams` sub-commands
+constexpr std::array team_options{
+    option_spec{dpp::co_integer, "team-count", "Number of teams to generate, this or `team-size` is required"},
+    option_spec{dpp::co_integer, "team-size", "Number members per team, this or `team-count` is required"},
+    option_spec{dpp::co_user, "captain-1", "Captain of the 1st team"},
+    option_spec{dpp::co_user, "captain-2", "Captain of the 2nd team"},
+    option_spec{dpp::co_user, "captain-3", "Captain of the 3rd team"},
+    option_spec{dpp::co_user, "captain-4", "Captain of the 4th team"},
+    option_spec{dpp::co_boolean, "diverse", "Split up people who've often been on a team together"},
+};
+
+constexpr auto team_channel_options = join_options(
+    std::array{option_spec{dpp::co_channel, "channel", "Channel with people in it", required_param}},
+    team_options,
+    std::array{
+        option_spec{dpp::co_channel, "voice-1", "Voice channel to move the 1st team into"},
+        option_spec{dpp::co_channel, "voice-2", "Voice channel to move the 2nd team into"},
+        option_spec{dpp::co_channel, "voice-3", "Voice channel to move the 3rd team into"},
+        option_spec{dpp::co_channel, "voice-4", "Voice channel to move the 4th team into"},
+    });
+
+constexpr auto team_event_options = join_options(
+    std::array{option_spec{dpp::co_string, "event-url", "The URL of the event to pull participants from", required_param}},
+    team_options);
+
+constexpr std::array teams_subcommands{
+    option_spec{dpp::co_sub_command, "channel", "Generate teams from members of a channel",
+        false, 0, 0, team_channel_options},
+    option_spec{dpp::co_sub_command, "event", "Generate teams from people interested in an event",
+        false, 0, 0, team_event_options},
+};
+
+// ----- Registry -----
+constexpr std::array commands{
+    command_spec{"bone-sailor", "Engages in some jolly insult fights",
+        {}, command_executor::inline_handler, bone_sailor},
+    command_spec{"bone-sus", "Bring the crew-mates in on an image",
+        sus_options, command_executor::heavy_pool, bone_sus},
+    command_spec{"bone-teams", "Generate teams from an event/channel/etc.",
+        teams_subcommands, command_executor::inline_handler, bone_teams},
+    command_spec{"bone-about", "Names and shames the people responsible for this bot",
+        {}, command_executor::inline_handler, bone_about},
+};
+// clang-format on
+
+// ----- Dispatch -----
+// FNV-1a with a seed folded into the offset basis
+constexpr std::uint32_t name_hash(const std::string_view name, const std::uint32_t seed) {
+  auto hash = 2166136261U ^ seed;
+  for (const auto c : name) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+constexpr std::size_t dispatch_slot_count{std::bit_ceil(commands.size() * 2)};
+
+struct dispatch_table {
+  std::uint32_t seed{0};
+  // Index into `commands` plus one, 0 for an empty slot
+  std::array<std::uint8_t, dispatch_slot_count> slots{};
+};
+
+// Tries seeds until every command name lands in its own slot, so a lookup is one hash and one compare
+constexpr dispatch_table make_dispatch_table() {
+  for (std::uint32_t seed = 0; seed < 1'000'000; seed++) {
+    dispatch_table table{seed, {}};
+    auto collided{false};
+    for (std::size_t i = 0; i < commands.size() && !collided; i++) {
+      auto &slot = table.slots[name_hash(commands[i].name, seed) & (dispatch_slot_count - 1)];
+      collided = slot != 0;
+      slot = static_cast<std::uint8_t>(i + 1);
+    }
+    if (!collided)
+      return table;
+  }
+  throw std::logic_error("No perfect hash seed for the command names");
+}
+
+constexpr auto dispatch = make_dispatch_table();
+
+constexpr const command_spec *lookup(const std::string_view name) {
+  const auto slot = dispatch.slots[name_hash(name, dispatch.seed) & (dispatch_slot_count - 1)];
+  if (slot == 0 || commands[slot - 1].name != name)
+    return nullptr;
+  return &commands[slot - 1];
+}
+
+static_assert(std::ranges::all_of(commands, [](const command_spec &command) {
+  return lookup(command.name) == &command;
+}));
+
+dpp::command_option make_option(const option_spec &spec) {
+  dpp::command_option option{spec.type, std::string{spec.name}, std::string{spec.description}, spec.required};
+  if (spec.min_value != 0 || spec.max_value != 0) {
+    option.set_min_value(spec.min_value);
+    option.set_max_value(spec.max_value);
+  }
+  for (const auto &sub_option : spec.options)
+    option.add_option(make_option(sub_option));
+  return option;
+}
+} // namespace
+
+std::span<const command_spec> command_registry() {
+  return commands;
+}
+
+const command_spec *find_command(const std::string_view name) {
+  return lookup(name);
+}
+
+std::vector<dpp::slashcommand> make_slashcommands(const dpp::snowflake application_id) {
+  std::vector<dpp::slashcommand> result;
+  result.reserve(commands.size());
+  for (const auto &command : commands) {
+    dpp::slashcommand slashcommand{std::string{command.name}, std::string{command.description}, application_id};
+    for (const auto &option : command.options)
+      slashcommand.add_option(make_option(option));
+    result.push_back(std::move(slashcommand));
+  }
+  return result;
+}
+
+dpp::task<void> run_command(const dpp::slashcommand_t &event, bot_context &context) {
+  spdlog::debug("On slash command");
+  const auto *command = find_command(event.command.get_command_name());
+  if (command == nullptr) {
+    spdlog::warn("Got unregistered command '{}'", event.command.get_command_name());
+    co_return;
+  }
+
+  const Responder responder{event, context.discord, context.defer_after};
+
+  if (command->executor == command_executor::heavy_pool) {
+    // Held until the handler is done, not just until its first hop, so it still counts while it waits on Discord
+    const auto admitted = context.heavy_pool.try_admit();
+    if (!admitted) {
+      spdlog::warn("Too many heavy commands in flight, turning away '{}'", command->name);
+      responder.respond("Too many of those going right now, try again in a bit");
+      co_return;
+    }
+
+    co_await context.heavy_pool.schedule();
+    co_await command->handler(event, responder, context);
+    co_return;
+  }
+
+  co_await command->handler(event, responder, context);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "bounded_pool.h"
+#include "discord_api.h"
+#include "insults.h"
+#include "render_load.h"
+#include "responder.h"
+#include "team_history.h"
+#include <chrono>
+#include <cstdint>
+#include <dpp/dpp.h>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Everything the command handlers share
+struct bot_context {
+  // Every call to Discord goes through here
+  DiscordApi &discord;
+  InsultStreams &insults;
+  TeamHistory &team_history;
+  // Heavy commands run here instead of on DPP's threads
+  BoundedPool &heavy_pool;
+  // Cuts `bone-sus` quality back when it's busy
+  RenderLoad &sus_load;
+  std::chrono::milliseconds defer_after;
+  // rusty-sussy, which does the `bone-sus` rendering
+  std::filesystem::path sus_binary;
+  std::filesystem::path sus_input_images_path;
+  std::filesystem::path sus_output_images_path;
+};
+
+// Where a command's handler runs
+enum class command_executor {
+  inline_handler, // Straight on the DPP thread that got the interaction, for quick commands
+  heavy_pool,     // Hops onto `bot_context::heavy_pool` first, turned away if too many are already in flight
+};
+
+using command_handler = dpp::task<void> (*)(
+    const dpp::slashcommand_t &event, const Responder &responder, bot_context &context);
+
+struct option_spec {
+  dpp::command_option_type type{};
+  std::string_view name;
+  std::string_view description;
+  bool required{false};
+  // Only for integer options, both 0 means no limits
+  std::int64_t min_value{0};
+  std::int64_t max_value{0};
+  // Only for sub-commands
+  std::span<const option_spec> options{};
+};
+
+// A slash command, declared once.
+// Both the `dpp::slashcommand` registered with Discord and the dispatch table are built from these
+struct command_spec {
+  std::string_view name;
+  std::string_view description;
+  std::span<const option_spec> options;
+  command_executor executor;
+  command_handler handler;
+};
+
+// Every command, in the order they're registered
+std::span<const command_spec> command_registry();
+
+// Perfect-hash lookup by name, `nullptr` for anything that isn't registered
+const command_spec *find_command(std::string_view name);
+
+std::vector<dpp::slashcommand> make_slashcommands(dpp::snowflake application_id);
+
+// Looks up the command, responds through a `Responder`, and runs the handler on its executor
+dpp::task<void> run_command(const dpp::slashcommand_t &event, bot_context &context);
@@ -0,0 +1,93 @@
+#include "discord_api.h"
+#include <utility>
+
+dpp::async<dpp::confirmation_callback_t> DiscordApi::co_channel_get(const dpp::snowflake channel_id) {
+  return dpp::async<dpp::confirmation_callback_t>{this, &DiscordApi::channel_get, channel_id};
+}
+
+dpp::async<dpp::confirmation_callback_t> DiscordApi::co_guild_get_member(
+    const dpp::snowflake guild_id, const dpp::snowflake user_id) {
+  return dpp::async<dpp::confirmation_callback_t>{this, &DiscordApi::guild_get_member, guild_id, user_id};
+}
+
+dpp::async<dpp::confirmation_callback_t> DiscordApi::co_guild_member_move(
+    const dpp::snowflake channel_id, const dpp::snowflake guild_id, const dpp::snowflake user_id) {
+  return dpp::async<dpp::confirmation_callback_t>{this, &DiscordApi::guild_member_move, channel_id, guild_id, user_id};
+}
+
+dpp::async<dpp::confirmation_callback_t> DiscordApi::co_guild_event_get(
+    const dpp::snowflake guild_id, const dpp::snowflake event_id) {
+  return dpp::async<dpp::confirmation_callback_t>{this, &DiscordApi::guild_event_get, guild_id, event_id};
+}
+
+dpp::async<dpp::confirmation_callback_t> DiscordApi::co_guild_event_users_get(
+    const dpp::snowflake guild_id, const dpp::snowflake event_id) {
+  return dpp::async<dpp::confirmation_callback_t>{this, &DiscordApi::guild_event_users_get, guild_id, event_id};
+}
+
+dpp::async<dpp::confirmation_callback_t> DiscordApi::co_message_get(
+    const dpp::snowflake message_id, const dpp::snowflake channel_id) {
+  return dpp::async<dpp::confirmation_callback_t>{this, &DiscordApi::message_get, message_id, channel_id};
+}
+
+dpp::async<dpp::confirmation_callback_t> DiscordApi::co_message_create(const dpp::message &message) {
+  return dpp::async<dpp::confirmation_callback_t>{this, &DiscordApi::message_create, message};
+}
+
+dpp::async<dpp::http_request_completion_t> DiscordApi::co_download(const std::string &url) {
+  return dpp::async<dpp::http_request_completion_t>{this, &DiscordApi::download, url};
+}
+
+ClusterApi::ClusterApi(dpp::cluster &bot) : bot(bot) {
+}
+
+void ClusterApi::interaction_reply(
+    const dpp::slashcommand_t &event, const dpp::message &message, dpp::command_completion_event_t callback) {
+  event.reply(message, std::move(callback));
+}
+
+void ClusterApi::interaction_defer(const dpp::slashcommand_t &event, dpp::command_completion_event_t callback) {
+  event.thinking(false, std::move(callback));
+}
+
+void ClusterApi::interaction_edit(
+    const dpp::slashcommand_t &event, const dpp::message &message, dpp::command_completion_event_t callback) {
+  event.edit_response(message, std::move(callback));
+}
+
+void ClusterApi::channel_get(const dpp::snowflake channel_id, dpp::command_completion_event_t callback) {
+  bot.channel_get(channel_id, std::move(callback));
+}
+
+void ClusterApi::guild_get_member(
+    const dpp::snowflake guild_id, const dpp::snowflake user_id, dpp::command_completion_event_t callback) {
+  bot.guild_get_member(guild_id, user_id, std::move(callback));
+}
+
+void ClusterApi::guild_member_move(const dpp::snowflake channel_id, const dpp::snowflake guild_id,
+    const dpp::snowflake user_id, dpp::command_completion_event_t callback) {
+  bot.guild_member_move(channel_id, guild_id, user_id, std::move(callback));
+}
+
+void ClusterApi::guild_event_get(
+    const dpp::snowflake guild_id, const dpp::snowflake event_id, dpp::command_completion_event_t callback) {
+  bot.guild_event_get(guild_id, event_id, std::move(callback));
+}
+
+void ClusterApi::guild_event_users_get(
+    const dpp::snowflake guild_id, const dpp::snowflake event_id, dpp::command_completion_event_t callback) {
+  bot.guild_event_users_get(guild_id, event_id, std::move(callback));
+}
+
+void ClusterApi::message_get(
+    const dpp::snowflake message_id, const dpp::snowflake channel_id, dpp::command_completion_event_t callback) {
+  bot.message_get(message_id, channel_id, std::move(callback));
+}
+
+void ClusterApi::message_create(const dpp::message &message, dpp::command_completion_event_t callback) {
+  bot.message_create(message, std::move(callback));
+}
+
+void ClusterApi::download(const std::string &url, dpp::http_completion_event callback) {
+  bot.request(url, dpp::m_get, std::move(callback));
+}
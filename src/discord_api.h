@@ -0,0 +1,72 @@
+#pragma once
+#include <dpp/dpp.h>
+#include <string>
+
+// The Discord calls the handlers make, so they can run against something other than discord.com.
+// Callbacks are the same as `dpp::cluster`'s, and the `co_` versions wrap them the same way DPP does.
+// `ClusterApi` is the real one, `bone_loadgen` has a stand-in that talks to a local `FakeDiscord`
+class DiscordApi {
+public:
+  virtual ~DiscordApi() = default;
+
+  // Answering an interaction, `event` is the one being answered
+  virtual void interaction_reply(
+      const dpp::slashcommand_t &event, const dpp::message &message, dpp::command_completion_event_t callback) = 0;
+  // "Bone Bot is thinking..."
+  virtual void interaction_defer(const dpp::slashcommand_t &event, dpp::command_completion_event_t callback) = 0;
+  virtual void interaction_edit(
+      const dpp::slashcommand_t &event, const dpp::message &message, dpp::command_completion_event_t callback) = 0;
+
+  virtual void channel_get(dpp::snowflake channel_id, dpp::command_completion_event_t callback) = 0;
+  virtual void guild_get_member(
+      dpp::snowflake guild_id, dpp::snowflake user_id, dpp::command_completion_event_t callback) = 0;
+  virtual void guild_member_move(dpp::snowflake channel_id, dpp::snowflake guild_id, dpp::snowflake user_id,
+      dpp::command_completion_event_t callback) = 0;
+  virtual void guild_event_get(
+      dpp::snowflake guild_id, dpp::snowflake event_id, dpp::command_completion_event_t callback) = 0;
+  virtual void guild_event_users_get(
+      dpp::snowflake guild_id, dpp::snowflake event_id, dpp::command_completion_event_t callback) = 0;
+  virtual void message_get(
+      dpp::snowflake message_id, dpp::snowflake channel_id, dpp::command_completion_event_t callback) = 0;
+  virtual void message_create(const dpp::message &message, dpp::command_completion_event_t callback) = 0;
+  // Plain GET, for attachments on the CDN
+  virtual void download(const std::string &url, dpp::http_completion_event callback) = 0;
+
+  dpp::async<dpp::confirmation_callback_t> co_channel_get(dpp::snowflake channel_id);
+  dpp::async<dpp::confirmation_callback_t> co_guild_get_member(dpp::snowflake guild_id, dpp::snowflake user_id);
+  dpp::async<dpp::confirmation_callback_t> co_guild_member_move(
+      dpp::snowflake channel_id, dpp::snowflake guild_id, dpp::snowflake user_id);
+  dpp::async<dpp::confirmation_callback_t> co_guild_event_get(dpp::snowflake guild_id, dpp::snowflake event_id);
+  dpp::async<dpp::confirmation_callback_t> co_guild_event_users_get(dpp::snowflake guild_id, dpp::snowflake event_id);
+  dpp::async<dpp::confirmation_callback_t> co_message_get(dpp::snowflake message_id, dpp::snowflake channel_id);
+  dpp::async<dpp::confirmation_callback_t> co_message_create(const dpp::message &message);
+  dpp::async<dpp::http_request_completion_t> co_download(const std::string &url);
+};
+
+// Straight through to Discord
+class ClusterApi : public DiscordApi {
+  dpp::cluster &bot;
+
+public:
+  explicit ClusterApi(dpp::cluster &bot);
+
+  void interaction_reply(const dpp::slashcommand_t &event, const dpp::message &message,
+      dpp::command_completion_event_t callback) override;
+  void interaction_defer(const dpp::slashcommand_t &event, dpp::command_completion_event_t callback) override;
+  void interaction_edit(const dpp::slashcommand_t &event, const dpp::message &message,
+      dpp::command_completion_event_t callback) override;
+
+  void channel_get(dpp::snowflake channel_id, dpp::command_completion_event_t callback) override;
+  void guild_get_member(
+      dpp::snowflake guild_id, dpp::snowflake user_id, dpp::command_completion_event_t callback) override;
+  void guild_member_move(dpp::snowflake channel_id, dpp::snowflake guild_id, dpp::snowflake user_id,
+      dpp::command_completion_event_t callback) override;
+  void guild_event_get(
+      dpp::snowflake guild_id, dpp::snowflake event_id, dpp::command_completion_event_t callback) override;
+  void guild_event_users_get(
+      dpp::snowflake guild_id, dpp::snowflake event_id, dpp::command_completion_event_t callback) override;
+  void message_get(
+      dpp::snowflake message_id, dpp::snowflake channel_id, dpp::command_completion_event_t callback) override;
+  void message_create(const dpp::message &message, dpp::command_completion_event_t callback) override;
+  void download(const std::string &url, dpp::http_completion_event callback) override;
+};
@@ -0,0 +1,358 @@
+#include "fake_discord.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <charconv>
+#include <fmt/format.h>
+#include <netinet/in.h>
+#include <ranges>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <string_view>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+// Discord's message types, only the ones the reply searcher cares about
+constexpr int message_type_reply{19};
+constexpr int message_type_application_command{20};
+
+constexpr std::uint64_t fake_guild_id{FakeDiscord::guild_id};
+constexpr std::uint64_t fake_channel_id{FakeDiscord::channel_id};
+constexpr std::uint64_t fake_application_id{FakeDiscord::application_id};
+constexpr std::uint64_t fake_bot_id{FakeDiscord::bot_id};
+// Fake user ids are offset from here, so they look like real snowflakes
+constexpr std::uint64_t fake_user_base{FakeDiscord::user_base};
+
+std::vector<std::string_view> split_path(std::string_view path) {
+  std::vector<std::string_view> parts;
+  for (const auto part : std::views::split(path, '/')) {
+    if (!part.empty())
+      parts.emplace_back(part.begin(), part.end());
+  }
+  return parts;
+}
+
+std::uint64_t parse_id(std::string_view text) {
+  std::uint64_t value{0};
+  std::from_chars(text.data(), text.data() + text.size(), value);
+  return value;
+}
+
+std::string user_json(std::uint64_t user_id) {
+  return fmt::format(R"({{"id":"{0}","username":"user-{0}","global_name":"User {0}","discriminator":"0"}})", user_id);
+}
+
+std::string member_json(std::uint64_t user_id) {
+  return fmt::format(R"({{"user":{},"nick":null,"roles":[],"joined_at":"2023-01-01T00:00:00.000000+00:00",)"
+                     R"("deaf":false,"mute":false,"flags":0}})",
+      user_json(user_id));
+}
+
+std::string message_json(std::uint64_t message_id, std::uint64_t channel_id, const std::string &content) {
+  return fmt::format(R"({{"id":"{}","channel_id":"{}","guild_id":"{}","type":0,"content":"{}","author":{}}})",
+      message_id, channel_id, fake_guild_id, content, user_json(fake_bot_id));
+}
+} // namespace
+
+FakeDiscord::FakeDiscord(options opts) : opts(opts), attachment_body(opts.attachment_size, '\x42') {
+}
+
+FakeDiscord::~FakeDiscord() {
+  stop();
+}
+
+void FakeDiscord::start() {
+  listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0)
+    throw std::runtime_error("FakeDiscord: failed to create socket");
+
+  const int reuse{1};
+  ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0; // Let the kernel pick, so parallel test runs don't collide
+
+  if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof address) != 0 ||
+      ::listen(listen_fd, SOMAXCONN) != 0) {
+    ::close(listen_fd);
+    throw std::runtime_error("FakeDiscord: failed to bind to localhost");
+  }
+
+  socklen_t address_length{sizeof address};
+  ::getsockname(listen_fd, reinterpret_cast<sockaddr *>(&address), &address_length);
+  listen_port = ntohs(address.sin_port);
+
+  running = true;
+  for (auto i = 0; i < opts.worker_count; i++)
+    workers.emplace_back(&FakeDiscord::worker_loop, this);
+  acceptor = std::thread{&FakeDiscord::accept_loop, this};
+
+  spdlog::info("FakeDiscord listening on {}", base_url());
+}
+
+void FakeDiscord::stop() {
+  if (!running.exchange(false))
+    return;
+
+  ::shutdown(listen_fd, SHUT_RDWR);
+  ::close(listen_fd);
+  acceptor.join();
+
+  pending_cv.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+  workers.clear();
+
+  for (const auto fd : pending_connections)
+    ::close(fd);
+  pending_connections.clear();
+}
+
+std::uint16_t FakeDiscord::port() const {
+  return listen_port;
+}
+
+std::string FakeDiscord::base_url() const {
+  return fmt::format("http://127.0.0.1:{}", listen_port);
+}
+
+std::string FakeDiscord::api_url() const {
+  return base_url() + "/api/v10";
+}
+
+std::uint64_t FakeDiscord::requests_served() const {
+  return served;
+}
+
+void FakeDiscord::accept_loop() {
+  while (running) {
+    const auto fd = ::accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+      continue; // Either shutting down, or a client gave up mid-handshake
+
+    {
+      std::lock_guard lock{pending_mutex};
+      pending_connections.push_back(fd);
+    }
+    pending_cv.notify_one();
+  }
+}
+
+void FakeDiscord::worker_loop() {
+  while (true) {
+    int fd;
+    {
+      std::unique_lock lock{pending_mutex};
+      pending_cv.wait(lock, [this] { return !running || !pending_connections.empty(); });
+      if (!running)
+        return;
+      fd = pending_connections.front();
+      pending_connections.pop_front();
+    }
+    serve_connection(fd);
+  }
+}
+
+void FakeDiscord::serve_connection(const int fd) {
+  // Don't let a stuck client pin a worker forever
+  const timeval timeout{5, 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+  std::string buffer;
+  char chunk[16 * 1024];
+  auto read_more = [&]() {
+    const auto received = ::recv(fd, chunk, sizeof chunk, 0);
+    if (received <= 0)
+      return false;
+    buffer.append(chunk, static_cast<std::size_t>(received));
+    return true;
+  };
+
+  auto header_end = buffer.find("\r\n\r\n");
+  while (header_end == std::string::npos) {
+    if (!read_more()) {
+      ::close(fd);
+      return;
+    }
+    header_end = buffer.find("\r\n\r\n");
+  }
+
+  http_request request;
+  const std::string_view head{buffer.data(), header_end};
+  const auto request_line = head.substr(0, head.find("\r\n"));
+  const auto method_end = request_line.find(' ');
+  const auto path_end = request_line.find(' ', method_end + 1);
+  request.method = request_line.substr(0, method_end);
+  request.path = request_line.substr(method_end + 1, path_end - method_end - 1);
+  if (const auto query = request.path.find('?'); query != std::string::npos)
+    request.path.resize(query);
+
+  std::size_t content_length{0};
+  for (auto line_start = head.find("\r\n"); line_start != std::string_view::npos;) {
+    line_start += 2;
+    const auto line_end = head.find("\r\n", line_start);
+    const auto line = head.substr(line_start, line_end - line_start);
+    line_start = line_end;
+
+    const auto colon = line.find(':');
+    if (colon == std::string_view::npos)
+      continue;
+    auto name = std::string{line.substr(0, colon)};
+    std::ranges::transform(name, name.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (name == "content-length")
+      content_length = parse_id(line.substr(line.find_first_not_of(' ', colon + 1)));
+  }
+
+  const auto body_start = header_end + 4;
+  while (buffer.size() < body_start + content_length) {
+    if (!read_more()) {
+      ::close(fd);
+      return;
+    }
+  }
+  request.body = buffer.substr(body_start, content_length);
+
+  const auto response = route(request);
+  // One request per connection keeps the worker model trivial,
+  // and is what the bot's raw HTTP client asks for anyway
+  const auto reply =
+      fmt::format("HTTP/1.1 {} {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+          response.status, response.status < 300 ? "OK" : "Error", response.content_type, response.body.size(),
+          response.body);
+
+  for (std::size_t sent{0}; sent < reply.size();) {
+    const auto written = ::send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+    if (written <= 0)
+      break;
+    sent += static_cast<std::size_t>(written);
+  }
+
+  served++;
+  ::close(fd);
+}
+
+FakeDiscord::http_response FakeDiscord::route(const http_request &request) const {
+  const auto parts = split_path(request.path);
+  const auto &method = request.method;
+
+  // CDN, downloaded by `bone-sus`
+  if (!parts.empty() && parts[0] == "attachments" && method == "GET")
+    return {200, "image/png", attachment_body};
+
+  if (parts.size() < 3 || parts[0] != "api")
+    return {404, "application/json", R"({"message":"404: Not Found","code":0})"};
+
+  // Drop the `/api/v10` prefix
+  const std::vector<std::string_view> route{parts.begin() + 2, parts.end()};
+
+  // POST /interactions/{id}/{token}/callback - both `thinking` and direct replies
+  if (route.size() == 4 && route[0] == "interactions" && route[3] == "callback" && method == "POST")
+    return {204, "application/json", ""};
+
+  // PATCH /webhooks/{application}/{token}/messages/@original - `edit_response`
+  if (route.size() == 5 && route[0] == "webhooks" && route[3] == "messages" && method == "PATCH")
+    return {200, "application/json", message_json(parse_id(route[1]), fake_channel_id, "edited")};
+
+  if (route.size() >= 2 && route[0] == "channels") {
+    const auto channel_id = parse_id(route[1]);
+
+    // GET /channels/{channel}
+    if (route.size() == 2 && method == "GET")
+      return {200, "application/json",
+          fmt::format(R"({{"id":"{}","guild_id":"{}","type":2,"name":"Voice","bitrate":64000,"user_limit":0}})",
+              channel_id, fake_guild_id)};
+
+    // POST /channels/{channel}/messages - the reply searcher's insult
+    if (route.size() == 3 && route[2] == "messages" && method == "POST")
+      return {200, "application/json", message_json(served + 1, channel_id, "insult")};
+
+    // GET /channels/{channel}/messages/{message} - walked by the reply searcher
+    if (route.size() == 4 && route[2] == "messages" && method == "GET") {
+      const auto message_id = parse_id(route[3]);
+      if (message_id % static_cast<std::uint64_t>(opts.reply_chain_length) == 0)
+        return {200, "application/json",
+            fmt::format(R"({{"id":"{}","channel_id":"{}","guild_id":"{}","type":{},"content":"",)"
+                        R"("author":{},"interaction":{{"id":"{}","type":2,"name":"bone-sailor","user":{}}}}})",
+                message_id, channel_id, fake_guild_id, message_type_application_command, user_json(fake_bot_id),
+                message_id, user_json(fake_user_base))};
+
+      return {200, "application/json",
+          fmt::format(R"({{"id":"{}","channel_id":"{}","guild_id":"{}","type":{},"content":"no u","author":{},)"
+                      R"("message_reference":{{"message_id":"{}","channel_id":"{}","guild_id":"{}"}}}})",
+              message_id, channel_id, fake_guild_id, message_type_reply, user_json(fake_user_base + message_id % 16),
+              message_id - 1, channel_id, fake_guild_id)};
+    }
+  }
+
+  if (route.size() >= 4 && route[0] == "guilds") {
+    // GET/PATCH /guilds/{guild}/members/{user}
+    if (route.size() == 4 && route[2] == "members" && (method == "GET" || method == "PATCH"))
+      return {200, "application/json", member_json(parse_id(route[3]))};
+
+    // GET /guilds/{guild}/scheduled-events/{event}
+    if (route.size() == 4 && route[2] == "scheduled-events" && method == "GET")
+      return {200, "application/json",
+          fmt::format(R"({{"id":"{}","guild_id":"{}","name":"Game night","status":1,"entity_type":2,)"
+                      R"("privacy_level":2,"user_count":{},"scheduled_start_time":"2023-01-01T00:00:00+00:00"}})",
+              route[3], fake_guild_id, opts.attendees)};
+
+    // GET /guilds/{guild}/scheduled-events/{event}/users
+    if (route.size() == 5 && route[2] == "scheduled-events" && route[4] == "users" && method == "GET") {
+      std::string users{"["};
+      for (auto i = 0; i < opts.attendees; i++) {
+        if (i != 0)
+          users += ',';
+        const auto user_id = fake_user_base + static_cast<std::uint64_t>(i);
+        users += fmt::format(R"({{"guild_scheduled_event_id":"{}","user":{},"member":{}}})", route[3],
+            user_json(user_id), member_json(user_id));
+      }
+      users += ']';
+      return {200, "application/json", users};
+    }
+  }
+
+  return {404, "application/json", R"({"message":"404: Not Found","code":0})"};
+}
+
+std::string FakeDiscord::dispatch_slash_command(const std::uint64_t interaction_id, const std::string &command,
+    const std::string &subcommand, const int team_count, const bool move_teams) {
+  std::string options{"[]"};
+  std::string resolved{"{}"};
+
+  if (command == "bone-teams" && subcommand == "channel") {
+    const auto voice_targets = move_teams ? fmt::format(R"(,{{"type":7,"name":"voice-1","value":"{}"}},)"
+                                                        R"({{"type":7,"name":"voice-2","value":"{}"}})",
+                                                fake_channel_id + 1, fake_channel_id + 2)
+                                          : std::string{};
+    options = fmt::format(R"([{{"type":1,"name":"channel","options":[{{"type":7,"name":"channel","value":"{}"}},)"
+                          R"({{"type":4,"name":"team-count","value":{}}}{}]}}])",
+        fake_channel_id, team_count, voice_targets);
+  } else if (command == "bone-teams" && subcommand == "event") {
+    options = fmt::format(R"([{{"type":1,"name":"event","options":[)"
+                          R"({{"type":3,"name":"event-url","value":"https://discord.com/events/{}/{}"}},)"
+                          R"({{"type":4,"name":"team-count","value":{}}}]}}])",
+        fake_guild_id, interaction_id, team_count);
+  } else if (command == "bone-sus") {
+    options = fmt::format(R"([{{"type":11,"name":"file","value":"{}"}}])", interaction_id);
+    resolved = fmt::format(R"({{"attachments":{{"{0}":{{"id":"{0}","filename":"sus.png","size":1,)"
+                           R"("content_type":"image/png","url":"https://cdn.discordapp.com/attachments/{1}/{0}/sus.png"}}}}}})",
+        interaction_id, fake_channel_id);
+  }
+
+  return fmt::format(R"({{"op":0,"t":"INTERACTION_CREATE","d":{{"id":"{0}","application_id":"{1}","type":2,)"
+                     R"("token":"token-{0}","version":1,"guild_id":"{2}","channel_id":"{3}",)"
+                     R"("member":{4},"data":{{"id":"{1}","name":"{5}","type":1,"options":{6},"resolved":{7}}}}}}})",
+      interaction_id, fake_application_id, fake_guild_id, fake_channel_id, member_json(fake_user_base), command,
+      options, resolved);
+}
+
+std::string FakeDiscord::dispatch_reply(const std::uint64_t message_id, const std::uint64_t referenced_message_id) {
+  return fmt::format(R"({{"op":0,"t":"MESSAGE_CREATE","d":{{"id":"{0}","channel_id":"{1}","guild_id":"{2}",)"
+                     R"("type":{3},"content":"no u","author":{4},)"
+                     R"("message_reference":{{"message_id":"{5}","channel_id":"{1}","guild_id":"{2}"}}}}}})",
+      message_id, fake_channel_id, fake_guild_id, message_type_reply, user_json(fake_user_base + 1),
+      referenced_message_id);
+}
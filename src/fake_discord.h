@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Localhost stand-in for the parts of Discord that bone-bot talks to.
+// Serves the REST routes and CDN downloads the handlers use with canned, well-formed
+// payloads, and builds the gateway dispatch frames that would normally arrive over the websocket.
+// Everything binds to 127.0.0.1, so the load generator runs offline.
+class FakeDiscord {
+public:
+  struct options {
+    int worker_count{8};
+    // Number of users returned for scheduled event / guild member lookups
+    int attendees{40};
+    // Every `reply_chain_length`th message id is the `bone-sailor` command that started a chain
+    int reply_chain_length{4};
+    // Size of the fake image served from the CDN route
+    std::size_t attachment_size{64 * 1024};
+  };
+
+  // Ids in every payload. The user who runs each command is `user_base`, attendees count up from there
+  static constexpr std::uint64_t guild_id{100000000000000001ULL};
+  static constexpr std::uint64_t channel_id{100000000000000002ULL};
+  static constexpr std::uint64_t application_id{100000000000000003ULL};
+  static constexpr std::uint64_t bot_id{100000000000000004ULL};
+  static constexpr std::uint64_t user_base{200000000000000000ULL};
+
+  explicit FakeDiscord(options opts);
+  ~FakeDiscord();
+
+  FakeDiscord(const FakeDiscord &) = delete;
+  FakeDiscord &operator=(const FakeDiscord &) = delete;
+
+  void start();
+  void stop();
+
+  [[nodiscard]] std::uint16_t port() const;
+  // e.g. http://127.0.0.1:12345
+  [[nodiscard]] std::string base_url() const;
+  // REST root, e.g. http://127.0.0.1:12345/api/v10
+  [[nodiscard]] std::string api_url() const;
+  [[nodiscard]] std::uint64_t requests_served() const;
+
+  // Gateway frames, as they'd be dispatched to the bot
+  // `move_teams` adds voice channels for the first two teams to be moved into
+  [[nodiscard]] static std::string dispatch_slash_command(std::uint64_t interaction_id, const std::string &command,
+      const std::string &subcommand = {}, int team_count = 2, bool move_teams = false);
+  [[nodiscard]] static std::string dispatch_reply(std::uint64_t message_id, std::uint64_t referenced_message_id);
+
+private:
+  struct http_request {
+    std::string method;
+    std::string path;
+    std::string body;
+  };
+
+  struct http_response {
+    int status{200};
+    std::string content_type{"application/json"};
+    std::string body;
+  };
+
+  [[nodiscard]] http_response route(const http_request &request) const;
+
+  void accept_loop();
+  void worker_loop();
+  void serve_connection(int fd);
+
+  options opts;
+  std::string attachment_body;
+
+  int listen_fd{-1};
+  std::uint16_t listen_port{0};
+  std::atomic_bool running{false};
+  std::atomic<std::uint64_t> served{0};
+
+  std::thread acceptor;
+  std::vector<std::thread> workers;
+  std::mutex pending_mutex;
+  std::condition_variable pending_cv;
+  std::deque<int> pending_connections;
+};
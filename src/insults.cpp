@@ -1,7 +1,12 @@
 #include "insults.h"
+#include "sampling.h"
+#include <array>
+#include <charconv>
 #include <chrono>
+#include <cmath>
 #include <fmt/format.h>
 #include <fstream>
+#include <limits>
 #include <random>
 #include <spdlog/spdlog.h>
 #include <sstream>
@@ -9,58 +14,76 @@
 #include <thread>
 #include <variant>
 
-std::default_random_engine random_engine{std::random_device{}()};
+// Picks which insult template to use
+std::mt19937_64 random_engine{std::random_device{}()};
 
-[[nodiscard]] std::string_view random_item(const std::vector<std::string> &w) {
-  return w[std::uniform_int_distribution<std::size_t>{0, w.size() - 1u}(random_engine)];
+SailorReplySearcher::SailorReplySearcher(DiscordApi &discord, InsultStreams &insults)
+    : insults(insults), discord(discord) {
 }
 
-SailorReplySearcher::SailorReplySearcher(dpp::cluster &bot, word_collection &words) : words(words), bot(bot) {
-}
-
-void SailorReplySearcher::set_begin(const dpp::message &root) {
-  beginning_message = root;
-}
-
-void SailorReplySearcher::send_insult_back(const dpp::message &last_message) {
-  dpp::message reply{fmt::format("Oh yeah {}! {}", last_message.author.get_mention(), make_insult(words)),
-                     dpp::mt_reply};
+dpp::async<dpp::confirmation_callback_t> SailorReplySearcher::send_insult_back(const dpp::message &last_message) {
+  dpp::message reply{
+      fmt::format("Oh yeah {}! {}", last_message.author.get_mention(), insults.insult(last_message.channel_id)),
+      dpp::mt_reply};
   reply.set_reference(last_message.id, last_message.guild_id, last_message.channel_id);
 
   reply.channel_id = last_message.channel_id;
   reply.guild_id = last_message.guild_id;
 
-  bot.message_create(reply);
+  return discord.co_message_create(reply);
 }
 
-void SailorReplySearcher::operator()(const dpp::confirmation_callback_t &cb) {
-  if (cb.is_error() || !std::holds_alternative<dpp::message>(cb.value)) {
-    spdlog::error("`SailorReplySearcher` failed to retrieve reply, exiting search");
-    return;
-  }
+dpp::task<void> SailorReplySearcher::search(const dpp::message reply) {
+  auto reference = reply.message_reference;
+  while (true) {
+    const auto cb = co_await discord.co_message_get(reference.message_id, reference.channel_id);
+    if (cb.is_error() || !std::holds_alternative<dpp::message>(cb.value)) {
+      spdlog::error("`SailorReplySearcher` failed to retrieve reply, exiting search");
+      co_return;
+    }
 
-  std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
 
-  const auto &msg = std::get<dpp::message>(cb.value);
-  if (msg.type == dpp::mt_reply) {
-    bot.message_get(msg.message_reference.message_id, msg.message_reference.channel_id,
-                    std::bind(&SailorReplySearcher::operator(), this, std::placeholders::_1)); // NOLINT(*-avoid-bind)
-    return;
-  }
+    const auto &msg = std::get<dpp::message>(cb.value);
+    if (msg.type != dpp::mt_reply) {
+      if (msg.type == dpp::mt_application_command && msg.interaction.name == "bone-sailor") {
+        spdlog::info("At end of 'bone-sailor' reply chain, deploying new insult");
+        const auto sent = co_await send_insult_back(reply);
+        if (sent.is_error())
+          spdlog::error("Failed to send insult back: {}", sent.get_error().human_readable);
+      }
+      co_return;
+    }
 
-  if (msg.type == dpp::mt_application_command && msg.interaction.name == "bone-sailor") {
-    spdlog::info("At end of 'bone-sailor' reply chain, deploying new insult");
-    send_insult_back(beginning_message);
+    reference = msg.message_reference;
   }
 }
 
-void read_in_words(const std::filesystem::path &file_path, std::vector<std::string> &word_class) {
+void read_in_words(const std::filesystem::path &file_path, word_list &word_class) {
   const auto begin_time = std::chrono::steady_clock::now();
   std::ifstream file{file_path};
 
   std::string line;
   while (std::getline(file, line)) {
-    word_class.emplace_back(line);
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+
+    double weight{1.0};
+    if (const auto tab = line.find('\t'); tab != std::string::npos) {
+      const auto weight_text = std::string_view{line}.substr(tab + 1);
+      const auto [end, error] = std::from_chars(weight_text.data(), weight_text.data() + weight_text.size(), weight);
+      // `from_chars` takes "nan" and "inf" as well
+      if (error != std::errc{} || !std::isfinite(weight) || weight < 0.0) {
+        spdlog::warn("Bad weight '{}' in {}, using 1", weight_text, file_path.string());
+        weight = 1.0;
+      }
+      line.resize(tab);
+    }
+
+    if (line.empty() || weight == 0.0)
+      continue;
+
+    word_class.words.emplace_back(line);
   }
 
   const auto end_time = std::chrono::steady_clock::now();
@@ -68,48 +91,159 @@ void read_in_words(const std::filesystem::path &file_path, std::vector<std::stri
                std::chrono::duration_cast<std::chrono::microseconds>(end_time - begin_time).count());
 }
 
-std::string make_insult(const word_collection &w) {
-  switch (std::uniform_int_distribution<>{0, 8}(random_engine)) {
-  case 0:
-    return fmt::format("I'll eat yer {} and drink your {} ye {}, {}, {} {}!", random_item(w.nouns),
-                       random_item(w.nouns), random_item(w.adjectives), random_item(w.adjectives),
-                       random_item(w.adjectives), random_item(w.nouns));
-  case 1:
-    return fmt::format("My {} has a smaller nose than ye, you {}, {}, {} {}!", random_item(w.nouns),
-                       random_item(w.adjectives), random_item(w.adjectives), random_item(w.adjectives),
-                       random_item(w.nouns));
-  case 2:
-    return fmt::format("Ya fight like a {}, you {}, {}, {} {}!", random_item(w.nouns), random_item(w.adjectives),
-                       random_item(w.adjectives), random_item(w.adjectives), random_item(w.nouns));
-  case 3:
-    return fmt::format("Yer as [smart, dumb] as a {}, you {}, {}, {} {}!", random_item({"smart", "dumb"}),
-                       random_item(w.nouns), random_item(w.adjectives), random_item(w.adjectives),
-                       random_item(w.adjectives), random_item(w.nouns));
-  case 4:
-    return fmt::format("Yer breath could kill a {}, ya {}, {}, {} {}!", random_item(w.nouns), random_item(w.adjectives),
-                       random_item(w.adjectives), random_item(w.adjectives), random_item(w.nouns));
-  case 5: {
-    std::vector<std::string> base_insult{"was a", "smelt of", "licked a", "kissed a", "tastes of"};
-    return fmt::format("Yer mother {} {} and your father {} {}", random_item(base_insult), random_item(w.nouns),
-                       random_item(base_insult), random_item(w.nouns));
-  }
-  case 6:
-    return fmt::format("You be a {}, {}, {} {}, who's only good for {} {}", random_item(w.adjectives),
-                       random_item(w.adjectives), random_item(w.adjectives), random_item(w.nouns), random_item(w.verbs),
-                       random_item(w.nouns_plural));
-  case 7:
-    return fmt::format("You don't need a {}, yer face be deadlier, you {}, {}, {} {}!", random_item(w.nouns),
-                       random_item(w.adjectives), random_item(w.adjectives), random_item(w.adjectives),
-                       random_item(w.nouns));
-  case 8:
+namespace {
+// Where each `{}` in a phrase template gets its words from
+enum class slot { noun, noun_plural, adjective, verb, smart_or_dumb, parent_deed, removal };
+
+constexpr std::size_t max_slots{8};
+
+struct phrase_template {
+  std::string_view format;
+  std::vector<slot> slots;
+};
+
+const word_list smart_or_dumb{{"smart", "dumb"}};
+const word_list parent_deeds{{"was a", "smelt of", "licked a", "kissed a", "tastes of"}};
+const word_list removals{{"cut out", "pull out", "yank out", "cleave off"}};
+
+// clang-format off
+const std::array<phrase_template, insult_template_count> insult_templates{{
+    {"I'll eat yer {} and drink your {} ye {}, {}, {} {}!",
+        {slot::noun, slot::noun, slot::adjective, slot::adjective, slot::adjective, slot::noun}},
+    {"My {} has a smaller nose than ye, you {}, {}, {} {}!",
+        {slot::noun, slot::adjective, slot::adjective, slot::adjective, slot::noun}},
+    {"Ya fight like a {}, you {}, {}, {} {}!",
+        {slot::noun, slot::adjective, slot::adjective, slot::adjective, slot::noun}},
+    {"Yer as [smart, dumb] as a {}, you {}, {}, {} {}!",
+        {slot::smart_or_dumb, slot::noun, slot::adjective, slot::adjective, slot::adjective}},
+    {"Yer breath could kill a {}, ya {}, {}, {} {}!",
+        {slot::noun, slot::adjective, slot::adjective, slot::adjective, slot::noun}},
+    {"Yer mother {} {} and your father {} {}",
+        {slot::parent_deed, slot::noun, slot::parent_deed, slot::noun}},
+    {"You be a {}, {}, {} {}, who's only good for {} {}",
+        {slot::adjective, slot::adjective, slot::adjective, slot::noun, slot::verb, slot::noun_plural}},
+    {"You don't need a {}, yer face be deadlier, you {}, {}, {} {}!",
+        {slot::noun, slot::adjective, slot::adjective, slot::adjective, slot::noun}},
+    {"I'll {} yer {} and feed it to the {}, ya {}, {}, {} {}!",
+        {slot::removal, slot::noun, slot::noun_plural, slot::adjective, slot::adjective, slot::adjective, slot::noun}},
+}};
+// clang-format on
+
+const phrase_template team_name_template{"{} {}", {slot::adjective, slot::noun_plural}};
+
+const word_list &slot_words(const word_collection &w, const slot s) {
+  switch (s) {
+  case slot::noun:
+    return w.nouns;
+  case slot::noun_plural:
+    return w.nouns_plural;
+  case slot::adjective:
+    return w.adjectives;
+  case slot::verb:
+    return w.verbs;
+  case slot::smart_or_dumb:
+    return smart_or_dumb;
+  case slot::parent_deed:
+    return parent_deeds;
+  case slot::removal:
     [[fallthrough]];
   default:
-    return fmt::format("I'll {} yer {} and feed it to the {}, ya {}, {}, {} {}!",
-                       random_item({"cut out", "pull out", "yank out", "cleave off"}), random_item(w.nouns),
-                       random_item(w.nouns_plural), random_item(w.adjectives), random_item(w.adjectives),
-                       random_item(w.adjectives), random_item(w.nouns));
+    return removals;
   }
 }
-std::string team_name(const word_collection &w) {
-  return fmt::format("{} {}", random_item(w.adjectives), random_item(w.nouns_plural));
+
+using phrase_words = std::array<std::string_view, max_slots>;
+
+std::string format_phrase(const phrase_template &t, const phrase_words &words) {
+  // Unused trailing arguments are ignored by fmt
+  return fmt::format(fmt::runtime(t.format), words[0], words[1], words[2], words[3], words[4], words[5], words[6],
+                     words[7]);
+}
+
+// Number of distinct phrases a template can make, saturating at 2^64 - 1.
+// Anything past that is more than any channel will ever see
+std::uint64_t combination_count(const word_collection &w, const phrase_template &t) {
+  std::uint64_t count{1};
+  for (const auto s : t.slots) {
+    const auto size = static_cast<std::uint64_t>(slot_words(w, s).words.size());
+    if (size != 0 && count > std::numeric_limits<std::uint64_t>::max() / size)
+      return std::numeric_limits<std::uint64_t>::max();
+    count *= size;
+  }
+  return count;
+}
+
+// Mixed radix decode, each slot's word is one digit of the combination index.
+// If the template saturated `combination_count`, the index runs out before the last slot:
+// the slot it runs out on has what's left spread across all of it, and any after that are
+// filled from a hash of the index. Either way, distinct indices make distinct phrases
+std::string indexed_phrase(const word_collection &w, const phrase_template &t, const std::uint64_t index) {
+  phrase_words words{};
+  auto rest = index;
+  // Values `rest` can still take
+  auto remaining = combination_count(w, t);
+  for (std::size_t i = 0; i < t.slots.size(); i++) {
+    const auto &list = slot_words(w, t.slots[i]).words;
+    const auto size = static_cast<std::uint64_t>(list.size());
+
+    std::uint64_t digit;
+    if (remaining >= size) {
+      digit = rest % size;
+      rest /= size;
+      remaining = remaining / size + (remaining % size != 0);
+    } else if (remaining > 1) {
+      digit = static_cast<std::uint64_t>(static_cast<unsigned __int128>(rest) * size / remaining);
+      remaining = 1;
+    } else {
+      digit = mix64(index ^ mix64(i)) % size;
+    }
+    words[i] = list[digit];
+  }
+  return format_phrase(t, words);
+}
+} // namespace
+
+InsultStreams::InsultStreams(const word_collection &words) : words(words), seed(std::random_device{}()) {
+  seed = (seed << 32) | std::random_device{}();
+  for (std::size_t i = 0; i < insult_templates.size(); i++)
+    insult_space[i] = combination_count(words, insult_templates[i]);
+  team_name_space = combination_count(words, team_name_template);
+}
+
+std::string InsultStreams::next(const dpp::snowflake channel, const std::size_t stream, const std::uint64_t space) {
+  if (space == 0)
+    return {}; // Missing a word list
+  std::uint64_t used;
+  std::uint64_t channel_key;
+  {
+    std::lock_guard lock{mutex};
+    auto [state, inserted] = channels.try_emplace(channel);
+    if (inserted)
+      state->second.key = mix64(seed ^ static_cast<std::uint64_t>(channel));
+    channel_key = state->second.key;
+    used = state->second.used[stream]++;
+  }
+
+  // Once a template has been used up, the next pass gets a fresh key
+  const auto pass = used / space;
+  const FeistelPermutation permutation{space, channel_key ^ mix64((pass << 8) | stream)};
+  const auto index = permutation(used % space);
+
+  if (stream == insult_templates.size())
+    return indexed_phrase(words, team_name_template, index);
+  return indexed_phrase(words, insult_templates[stream], index);
+}
+
+std::string InsultStreams::insult(const dpp::snowflake channel) {
+  // The template is still picked at random, it's the words inside it that never repeat
+  std::size_t template_index;
+  {
+    std::lock_guard lock{mutex};
+    template_index = std::uniform_int_distribution<std::size_t>{0, insult_templates.size() - 1}(random_engine);
+  }
+  return next(channel, template_index, insult_space[template_index]);
+}
+
+std::string InsultStreams::team_name(const dpp::snowflake channel) {
+  return next(channel, insult_templates.size(), team_name_space);
 }
@@ -1,33 +1,74 @@
 #pragma once
+#include "discord_api.h"
+#include <array>
+#include <cstdint>
 #include <dpp/dpp.h>
+#include <mutex>
 #include <random>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+// Words from one file, each line is either `word` or `word<TAB>weight`.
+// A weight of 0 leaves the word out. `InsultStreams` gives every other word
+// the same share, so any other weight is accepted but doesn't change anything
+struct word_list {
+  std::vector<std::string> words;
+};
+
 struct word_collection {
-  std::vector<std::string> nouns;
-  std::vector<std::string> nouns_plural;
-  std::vector<std::string> adjectives;
-  std::vector<std::string> verbs;
+  word_list nouns;
+  word_list nouns_plural;
+  word_list adjectives;
+  word_list verbs;
 };
 
-class SailorReplySearcher {
-  word_collection &words;
-  dpp::cluster &bot;
-  dpp::message beginning_message;
 
-public:
-  explicit SailorReplySearcher(dpp::cluster &bot, word_collection &words);
+void read_in_words(const std::filesystem::path &file_path, word_list &word_class);
+
+constexpr std::size_t insult_template_count{9};
+
+// Insults and team names that don't repeat within a channel.
+// Every template's combinations are walked in a keyed Feistel order, so each
+// channel only needs a key and a counter per template: no history, no re-rolls.
+// After a template runs out of combinations it starts again in a new order.
+// Word weights are ignored here: every combination comes up once per pass, so
+// every word gets the same share. Only a weight of 0 (leaving the word out) counts
+class InsultStreams {
+  struct channel_state {
+    std::uint64_t key{};
+    // Combinations handed out per insult template, then for team names
+    std::array<std::uint64_t, insult_template_count + 1> used{};
+  };
+
+  const word_collection &words;
+  std::uint64_t seed;
+  std::array<std::uint64_t, insult_template_count> insult_space{};
+  std::uint64_t team_name_space{};
 
-  void set_begin(const dpp::message &root);
+  std::mutex mutex;
+  std::unordered_map<dpp::snowflake, channel_state> channels;
 
-  void send_insult_back(const dpp::message &last_message);
+  std::string next(dpp::snowflake channel, std::size_t stream, std::uint64_t space);
 
-  void operator()(const dpp::confirmation_callback_t &cb);
+public:
+  // `words` must be fully read in, the combination counts are taken here
+  explicit InsultStreams(const word_collection &words);
+
+  std::string insult(dpp::snowflake channel);
+
+  std::string team_name(dpp::snowflake channel);
 };
 
-void read_in_words(const std::filesystem::path &file_path, std::vector<std::string> &word_class);
+class SailorReplySearcher {
+  InsultStreams &insults;
+  DiscordApi &discord;
 
-std::string make_insult(const word_collection &w);
+public:
+  SailorReplySearcher(DiscordApi &discord, InsultStreams &insults);
+
+  // Walks up the chain `reply` is part of, and if a `bone-sailor` started it, insults whoever sent `reply`
+  dpp::task<void> search(dpp::message reply);
 
-std::string team_name(const word_collection &w);
+  dpp::async<dpp::confirmation_callback_t> send_insult_back(const dpp::message &last_message);
+};
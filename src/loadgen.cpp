@@ -0,0 +1,634 @@
+#include "bounded_pool.h"
+#include "commands.h"
+#include "discord_api.h"
+#include "fake_discord.h"
+#include "insults.h"
+#include "render_load.h"
+#include "team_history.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <dpp/dpp.h>
+#include <dpp/json.h>
+#include <exception>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// End-to-end load generator for bone-bot.
+// Starts a `FakeDiscord` on localhost, then replays gateway frames (recorded or synthetic) at a fixed rate
+// through the bot's own `run_command` and `SailorReplySearcher`, with their Discord calls sent to the stand-in.
+// Latency is measured from when each frame was *scheduled*, so a backed up bot shows up in the tail.
+
+namespace {
+using clock_type = std::chrono::steady_clock;
+
+struct loadgen_options {
+  double rate{200.0}; // frames per second
+  int count{0};       // 0: one pass over the replay file, or 1000 synthetic frames
+  int concurrency{32};
+  int attendees{40};
+  // Same as `[responses] defer-after-ms`, 0 defers every command like the bot used to
+  std::chrono::milliseconds defer_after{1000};
+  // Same as `[commands] heavy-threads` and `heavy-queue`
+  int heavy_threads{2};
+  int heavy_queue{16};
+  std::filesystem::path resources{"resources/"};
+  // A script that copies the input is used when this isn't given
+  std::optional<std::filesystem::path> sus_binary;
+  std::optional<std::filesystem::path> replay;
+  std::optional<std::filesystem::path> record;
+};
+
+void print_usage() {
+  fmt::print(R"(Usage: bone_loadgen [options]
+  --rate <n>            Frames replayed per second (default: 200)
+  --count <n>           Frames to replay (default: one pass over --replay, or 1000)
+  --concurrency <n>     Frames in flight at once (default: 32)
+  --attendees <n>       Members in each voice channel/event for `bone-teams` (default: 40)
+  --defer-after-ms <n>  Budget before a command is deferred, as in the config (default: 1000)
+  --heavy-threads <n>   Threads for `bone-sus`, as in the config (default: 2)
+  --heavy-queue <n>     Queue for `bone-sus`, as in the config (default: 16)
+  --resources <dir>     Directory holding the word lists (default: resources/)
+  --sus-binary <file>   rusty-sussy to render with (default: a script that copies the image back)
+  --replay <file>       Gateway frames to replay, one JSON object per line
+  --record <file>       Write the synthetic frames that were generated
+)");
+}
+
+std::optional<loadgen_options> parse_args(int argc, char **argv) {
+  loadgen_options opts;
+
+  for (auto i = 1; i < argc; i++) {
+    const std::string_view arg{argv[i]};
+    if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+      return {};
+
+    const std::string_view value{argv[++i]};
+    auto as_int = [&value]() {
+      int parsed{0};
+      std::from_chars(value.data(), value.data() + value.size(), parsed);
+      return parsed;
+    };
+
+    if (arg == "--rate")
+      opts.rate = std::stod(std::string{value});
+    else if (arg == "--count")
+      opts.count = as_int();
+    else if (arg == "--concurrency")
+      opts.concurrency = std::max(1, as_int());
+    else if (arg == "--attendees")
+      opts.attendees = std::max(1, as_int());
+    else if (arg == "--defer-after-ms")
+      opts.defer_after = std::chrono::milliseconds{std::max(0, as_int())};
+    else if (arg == "--heavy-threads")
+      opts.heavy_threads = std::max(1, as_int());
+    else if (arg == "--heavy-queue")
+      opts.heavy_queue = std::max(0, as_int());
+    else if (arg == "--resources")
+      opts.resources = value;
+    else if (arg == "--sus-binary")
+      opts.sus_binary = value;
+    else if (arg == "--replay")
+      opts.replay = value;
+    else if (arg == "--record")
+      opts.record = value;
+    else
+      return {};
+  }
+
+  if (opts.rate <= 0.0)
+    return {};
+
+  return opts;
+}
+
+// Rough mix of commands, weighted towards sailor fights
+std::vector<std::string> synthetic_frames(const int count) {
+  std::mt19937_64 engine{0xB0E};
+  std::discrete_distribution<> pick{40, 15, 15, 10, 5, 15, 5};
+
+  std::vector<std::string> frames;
+  frames.reserve(count);
+  for (auto i = 0; i < count; i++) {
+    const auto id = static_cast<std::uint64_t>(i + 1) * 64;
+    switch (pick(engine)) {
+    case 0:
+      frames.emplace_back(FakeDiscord::dispatch_slash_command(id, "bone-sailor"));
+      break;
+    case 1:
+      frames.emplace_back(FakeDiscord::dispatch_slash_command(id, "bone-teams", "channel"));
+      break;
+    case 2:
+      frames.emplace_back(FakeDiscord::dispatch_slash_command(id, "bone-teams", "event"));
+      break;
+    case 3:
+      frames.emplace_back(FakeDiscord::dispatch_slash_command(id, "bone-sus"));
+      break;
+    case 4:
+      frames.emplace_back(FakeDiscord::dispatch_slash_command(id, "bone-about"));
+      break;
+    case 6:
+      frames.emplace_back(FakeDiscord::dispatch_slash_command(id, "bone-teams", "channel", 2, true));
+      break;
+    default:
+      // Reply to a message 3 hops below the `bone-sailor` that started the chain
+      frames.emplace_back(FakeDiscord::dispatch_reply(id + 4, id + 3));
+      break;
+    }
+  }
+  return frames;
+}
+
+// Sends the handlers' Discord calls to a `FakeDiscord`, through the raw HTTP client DPP uses for REST.
+// Responses are parsed into the same types the cluster would hand back.
+// Interaction responses are counted per token, so a command only counts as done once its last one is acknowledged
+class StandInApi : public DiscordApi {
+  dpp::cluster &bot;
+  const FakeDiscord &discord;
+
+  struct interaction_state {
+    int in_flight{0};
+    int acknowledged{0};
+    bool failed{false};
+  };
+  std::mutex interactions_mutex;
+  std::condition_variable interactions_changed;
+  std::unordered_map<std::string, interaction_state> interactions;
+
+public:
+  std::atomic<std::uint64_t> rest_calls{0};
+  std::atomic<std::uint64_t> rest_errors{0};
+
+  StandInApi(dpp::cluster &bot, const FakeDiscord &discord) : bot(bot), discord(discord) {
+  }
+
+  void interaction_reply(const dpp::slashcommand_t &event, const dpp::message &message,
+      dpp::command_completion_event_t callback) override {
+    respond(event,
+        fmt::format("{}/interactions/{}/{}/callback", discord.api_url(), event.command.id.str(), event.command.token),
+        dpp::m_post, fmt::format(R"({{"type":4,"data":{}}})", message.build_json()), std::move(callback));
+  }
+
+  void interaction_defer(const dpp::slashcommand_t &event, dpp::command_completion_event_t callback) override {
+    respond(event,
+        fmt::format("{}/interactions/{}/{}/callback", discord.api_url(), event.command.id.str(), event.command.token),
+        dpp::m_post, R"({"type":5})", std::move(callback));
+  }
+
+  void interaction_edit(const dpp::slashcommand_t &event, const dpp::message &message,
+      dpp::command_completion_event_t callback) override {
+    respond(event,
+        fmt::format("{}/webhooks/{}/{}/messages/@original", discord.api_url(), event.command.application_id.str(),
+            event.command.token),
+        dpp::m_patch, message.build_json(), std::move(callback));
+  }
+
+  void channel_get(const dpp::snowflake channel_id, dpp::command_completion_event_t callback) override {
+    call(fmt::format("{}/channels/{}", discord.api_url(), channel_id.str()), dpp::m_get, {}, std::move(callback),
+        [](dpp::json &j) -> dpp::confirmable_t { return dpp::channel{}.fill_from_json(&j); });
+  }
+
+  void guild_get_member(const dpp::snowflake guild_id, const dpp::snowflake user_id,
+      dpp::command_completion_event_t callback) override {
+    call(fmt::format("{}/guilds/{}/members/{}", discord.api_url(), guild_id.str(), user_id.str()), dpp::m_get, {},
+        std::move(callback), [guild_id, user_id](dpp::json &j) -> dpp::confirmable_t {
+          return dpp::guild_member{}.fill_from_json(&j, guild_id, user_id);
+        });
+  }
+
+  void guild_member_move(const dpp::snowflake channel_id, const dpp::snowflake guild_id, const dpp::snowflake user_id,
+      dpp::command_completion_event_t callback) override {
+    call(fmt::format("{}/guilds/{}/members/{}", discord.api_url(), guild_id.str(), user_id.str()), dpp::m_patch,
+        dpp::json{{"channel_id", channel_id.str()}}.dump(), std::move(callback),
+        [guild_id, user_id](dpp::json &j) -> dpp::confirmable_t {
+          return dpp::guild_member{}.fill_from_json(&j, guild_id, user_id);
+        });
+  }
+
+  void guild_event_get(const dpp::snowflake guild_id, const dpp::snowflake event_id,
+      dpp::command_completion_event_t callback) override {
+    call(fmt::format("{}/guilds/{}/scheduled-events/{}", discord.api_url(), guild_id.str(), event_id.str()),
+        dpp::m_get, {}, std::move(callback),
+        [](dpp::json &j) -> dpp::confirmable_t { return dpp::scheduled_event{}.fill_from_json(&j); });
+  }
+
+  void guild_event_users_get(const dpp::snowflake guild_id, const dpp::snowflake event_id,
+      dpp::command_completion_event_t callback) override {
+    call(fmt::format("{}/guilds/{}/scheduled-events/{}/users", discord.api_url(), guild_id.str(), event_id.str()),
+        dpp::m_get, {}, std::move(callback), [guild_id, event_id](dpp::json &j) -> dpp::confirmable_t {
+          dpp::event_member_map users;
+          for (auto &entry : j) {
+            dpp::event_member user;
+            user.guild_scheduled_event_id = event_id;
+            user.user = dpp::user{}.fill_from_json(&entry["user"]);
+            user.member = dpp::guild_member{}.fill_from_json(&entry["member"], guild_id, user.user.id);
+            users[user.user.id] = user;
+          }
+          return users;
+        });
+  }
+
+  void message_get(const dpp::snowflake message_id, const dpp::snowflake channel_id,
+      dpp::command_completion_event_t callback) override {
+    call(fmt::format("{}/channels/{}/messages/{}", discord.api_url(), channel_id.str(), message_id.str()), dpp::m_get,
+        {}, std::move(callback),
+        [](dpp::json &j) -> dpp::confirmable_t { return dpp::message{}.fill_from_json(&j); });
+  }
+
+  void message_create(const dpp::message &message, dpp::command_completion_event_t callback) override {
+    call(fmt::format("{}/channels/{}/messages", discord.api_url(), message.channel_id.str()), dpp::m_post,
+        message.build_json(), std::move(callback),
+        [](dpp::json &j) -> dpp::confirmable_t { return dpp::message{}.fill_from_json(&j); });
+  }
+
+  void download(const std::string &url, dpp::http_completion_event callback) override {
+    auto local_url = url;
+    if (const auto path = url.find("/attachments/"); path != std::string::npos)
+      local_url = discord.base_url() + url.substr(path);
+    send(local_url, dpp::m_get, {}, std::move(callback));
+  }
+
+  void begin_interaction(const std::string &token) {
+    std::lock_guard lock{interactions_mutex};
+    interactions[token] = {};
+  }
+
+  // Waits for the responses to `token` to be acknowledged.
+  // False if there were none, any failed, or they're still in flight after `timeout`
+  bool finish_interaction(const std::string &token, const std::chrono::milliseconds timeout) {
+    std::unique_lock lock{interactions_mutex};
+    const auto settled = interactions_changed.wait_for(lock, timeout, [this, &token] {
+      const auto &state = interactions[token];
+      return state.in_flight == 0 && state.acknowledged > 0;
+    });
+    const auto ok = settled && !interactions[token].failed;
+    interactions.erase(token);
+    return ok;
+  }
+
+private:
+  void send(const std::string &url, const dpp::http_method method, const std::string &body,
+      dpp::http_completion_event callback) {
+    bot.request(
+        url, method,
+        [this, url, callback = std::move(callback)](const dpp::http_request_completion_t &completion) {
+          rest_calls++;
+          if (completion.error != dpp::h_success || completion.status >= 300) {
+            rest_errors++;
+            spdlog::error("{} -> {} ({})", url, completion.status, static_cast<int>(completion.error));
+          }
+          callback(completion);
+        },
+        body, "application/json");
+  }
+
+  void call(const std::string &url, const dpp::http_method method, const std::string &body,
+      dpp::command_completion_event_t callback, std::function<dpp::confirmable_t(dpp::json &)> parse = {}) {
+    send(url, method, body,
+        [this, callback = std::move(callback), parse = std::move(parse)](
+            const dpp::http_request_completion_t &completion) {
+          auto result = completion;
+          if (result.error != dpp::h_success) {
+            // Make a dropped connection look like the error it is, DPP only checks the status
+            result.status = 599;
+            result.body = R"({"message":"Connection to the stand-in failed","code":0})";
+          }
+
+          dpp::confirmable_t value{dpp::confirmation{}};
+          if (result.status < 300 && parse) {
+            auto json = dpp::json::parse(result.body);
+            value = parse(json);
+          }
+          if (callback)
+            callback(dpp::confirmation_callback_t{&bot, value, result});
+        });
+  }
+
+  void respond(const dpp::slashcommand_t &event, const std::string &url, const dpp::http_method method,
+      const std::string &body, dpp::command_completion_event_t callback) {
+    const auto token = event.command.token;
+    {
+      std::lock_guard lock{interactions_mutex};
+      interactions[token].in_flight++;
+    }
+
+    call(url, method, body, [this, token, callback = std::move(callback)](const dpp::confirmation_callback_t &cb) {
+      // `Responder` sends anything it queued from in here, so that's in flight before this one is let go
+      if (callback)
+        callback(cb);
+      {
+        std::lock_guard lock{interactions_mutex};
+        auto &state = interactions[token];
+        state.in_flight--;
+        state.acknowledged++;
+        state.failed |= cb.is_error();
+      }
+      interactions_changed.notify_all();
+    });
+  }
+};
+
+// A started cluster fills these from the gateway, the handlers read voice members, channels, and permissions from them.
+// The member running each command owns the guild, so the 'Move Members' check always passes
+void fill_caches(const int attendees) {
+  auto *guild = new dpp::guild;
+  guild->id = FakeDiscord::guild_id;
+  guild->owner_id = FakeDiscord::user_base;
+  for (auto i = 0; i < attendees; i++) {
+    dpp::guild_member member;
+    member.guild_id = guild->id;
+    member.user_id = FakeDiscord::user_base + static_cast<std::uint64_t>(i);
+    guild->members[member.user_id] = member;
+
+    dpp::voicestate voice;
+    voice.guild_id = guild->id;
+    voice.channel_id = FakeDiscord::channel_id;
+    voice.user_id = member.user_id;
+    guild->voice_members[member.user_id] = voice;
+  }
+  dpp::get_guild_cache()->store(guild);
+
+  // The source channel and the two `voice-N` targets in `FakeDiscord::dispatch_slash_command`
+  for (auto i = 0; i < 3; i++) {
+    auto *channel = new dpp::channel;
+    channel->id = FakeDiscord::channel_id + static_cast<std::uint64_t>(i);
+    channel->guild_id = FakeDiscord::guild_id;
+    dpp::get_channel_cache()->store(channel);
+  }
+}
+
+// Stands in for rusty-sussy, `bone-sus` gets back the image it sent in
+std::filesystem::path write_fake_renderer(const std::filesystem::path &directory) {
+  const auto path = directory / "fake-rusty-sussy.sh";
+  std::ofstream script{path};
+  script << R"(#!/bin/sh
+for arg in "$@"; do
+  case "$arg" in
+    --input=*) input="${arg#--input=}" ;;
+    --output=*) output="${arg#--output=}" ;;
+  esac
+done
+cp "$input" "$output"
+)";
+  script.close();
+  std::filesystem::permissions(path, std::filesystem::perms::owner_all);
+  return path;
+}
+
+// e.g. "bone-teams channel (move)"
+std::string command_label(const dpp::json &d) {
+  const auto &data = d.at("data");
+  auto label = data.at("name").get<std::string>();
+  if (!data.contains("options") || data.at("options").empty() || data.at("options").at(0).at("type") != 1)
+    return label;
+
+  const auto &subcommand = data.at("options").at(0);
+  label += " " + subcommand.at("name").get<std::string>();
+  for (const auto &option : subcommand.at("options")) {
+    if (option.at("name").get_ref<const std::string &>().starts_with("voice-"))
+      return label + " (move)";
+  }
+  return label;
+}
+
+// Runs `task` detached the way DPP runs coroutine event handlers, reporting back through `finished`
+dpp::job finish_task(dpp::task<void> task, std::promise<void> *finished) {
+  try {
+    co_await task;
+    finished->set_value();
+  } catch (...) {
+    finished->set_exception(std::current_exception());
+  }
+}
+
+struct latency_stats {
+  std::vector<double> milliseconds;
+  int errors{0};
+};
+
+double percentile(const std::vector<double> &sorted, const double p) {
+  if (sorted.empty())
+    return 0.0;
+  // Nearest-rank, so p999 of a small run is just the max
+  const auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+  return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const auto parsed = parse_args(argc, argv);
+  if (!parsed) {
+    print_usage();
+    return 2;
+  }
+  auto opts = parsed.value();
+
+  word_collection words;
+  read_in_words(opts.resources / "pirate-adjectives.txt", words.adjectives);
+  read_in_words(opts.resources / "pirate-nouns.txt", words.nouns);
+  read_in_words(opts.resources / "pirate-nouns-plural.txt", words.nouns_plural);
+  read_in_words(opts.resources / "pirate-verbs.txt", words.verbs);
+  if (words.adjectives.words.empty() || words.nouns.words.empty() || words.nouns_plural.words.empty() ||
+      words.verbs.words.empty()) {
+    spdlog::error("Could not read the word lists from '{}'", opts.resources.string());
+    return 1;
+  }
+
+  // ----- Traffic -----
+  std::vector<std::string> frames;
+  if (opts.replay) {
+    std::ifstream file{opts.replay.value()};
+    std::string line;
+    while (std::getline(file, line)) {
+      if (!line.empty())
+        frames.emplace_back(line);
+    }
+    if (frames.empty()) {
+      spdlog::error("No frames in replay file '{}'", opts.replay->string());
+      return 1;
+    }
+  } else {
+    frames = synthetic_frames(opts.count > 0 ? opts.count : 1000);
+  }
+
+  if (opts.record) {
+    std::ofstream file{opts.record.value()};
+    for (const auto &frame : frames)
+      file << frame << '\n';
+  }
+
+  const auto total = opts.count > 0 ? opts.count : static_cast<int>(frames.size());
+
+  std::vector<dpp::json> parsed_frames;
+  parsed_frames.reserve(frames.size());
+  for (const auto &frame : frames)
+    parsed_frames.emplace_back(dpp::json::parse(frame));
+
+  // ----- Stand-in + client -----
+  FakeDiscord discord{{.worker_count = opts.concurrency, .attendees = opts.attendees}};
+  discord.start();
+
+  // Never started, it's only here for its HTTP client.
+  // Raw request threads get one per in-flight frame so the client doesn't serialise the run
+  dpp::cluster bot{"bone-loadgen", dpp::i_default_intents, 0, 0, 1, true, dpp::cache_policy::cpol_default, 1,
+      static_cast<std::uint32_t>(opts.concurrency)};
+  StandInApi stand_in{bot, discord};
+  fill_caches(opts.attendees);
+
+  // ----- Bot -----
+  // Team history and `bone-sus` images go in a scratch directory, removed at the end
+  const auto scratch = std::filesystem::temp_directory_path() / fmt::format("bone-loadgen-{}", ::getpid());
+  std::filesystem::create_directories(scratch / "sus-input");
+  std::filesystem::create_directories(scratch / "sus-output");
+
+  InsultStreams insults{words};
+  TeamHistory team_history{scratch / "team-history"};
+  BoundedPool heavy_pool{static_cast<std::size_t>(opts.heavy_threads), static_cast<std::size_t>(opts.heavy_queue)};
+  RenderLoad sus_load{{}};
+  bot_context context{stand_in, insults, team_history, heavy_pool, sus_load, opts.defer_after,
+      opts.sus_binary ? opts.sus_binary.value() : write_fake_renderer(scratch), scratch / "sus-input",
+      scratch / "sus-output"};
+  SailorReplySearcher reply_searcher{stand_in, insults};
+
+  // What `bot.on_slashcommand` and `bot.on_message_create` would do with the frame, returns false if it failed
+  auto run_frame = [&](const dpp::json &frame, const int index, std::string &label) {
+    const auto &type = frame.at("t").get_ref<const std::string &>();
+    auto d = frame.at("d");
+    std::promise<void> finished;
+
+    if (type == "INTERACTION_CREATE") {
+      label = command_label(d);
+      // Replays can go round the file more than once, each run needs a token of its own
+      d["token"] = fmt::format("{}-{}", d.at("token").get<std::string>(), index);
+
+      dpp::slashcommand_t event{nullptr, d.dump()};
+      event.command.fill_from_json(&d);
+      stand_in.begin_interaction(event.command.token);
+      finish_task(run_command(event, context), &finished);
+      finished.get_future().get();
+      return stand_in.finish_interaction(event.command.token, std::chrono::seconds{10});
+    }
+
+    if (type == "MESSAGE_CREATE") {
+      label = "reply-chain";
+      dpp::message reply;
+      reply.fill_from_json(&d);
+      finish_task(reply_searcher.search(reply), &finished);
+      finished.get_future().get();
+      return true; // A failed hop ends the chain quietly, it's counted in `rest_errors`
+    }
+
+    label = type;
+    return false;
+  };
+
+  // ----- Run -----
+  struct job {
+    int index;
+    clock_type::time_point scheduled;
+  };
+  std::mutex jobs_mutex;
+  std::condition_variable jobs_cv;
+  std::deque<job> jobs;
+  bool done_scheduling{false};
+
+  std::mutex stats_mutex;
+  std::map<std::string, latency_stats> stats;
+
+  auto worker = [&]() {
+    while (true) {
+      job next;
+      {
+        std::unique_lock lock{jobs_mutex};
+        jobs_cv.wait(lock, [&] { return done_scheduling || !jobs.empty(); });
+        if (jobs.empty())
+          return;
+        next = jobs.front();
+        jobs.pop_front();
+      }
+
+      std::string label{"unknown"};
+      bool ok{false};
+      try {
+        ok = run_frame(parsed_frames[next.index % parsed_frames.size()], next.index, label);
+      } catch (const std::exception &e) {
+        spdlog::error("Frame {} failed: {}", next.index, e.what());
+      }
+
+      const std::chrono::duration<double, std::milli> latency{clock_type::now() - next.scheduled};
+      std::lock_guard lock{stats_mutex};
+      for (auto *entry : {&stats[label], &stats["all"]}) {
+        entry->milliseconds.push_back(latency.count());
+        entry->errors += ok ? 0 : 1;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (auto i = 0; i < opts.concurrency; i++)
+    workers.emplace_back(worker);
+
+  spdlog::info("Replaying {} frames at {}/s", total, opts.rate);
+  const std::chrono::duration<double> interval{1.0 / opts.rate};
+  const auto begin_time = clock_type::now();
+
+  // Open loop: frames are scheduled on the clock, not when the last one finished
+  for (auto i = 0; i < total; i++) {
+    const auto scheduled = begin_time + std::chrono::duration_cast<clock_type::duration>(interval * i);
+    std::this_thread::sleep_until(scheduled);
+    {
+      std::lock_guard lock{jobs_mutex};
+      jobs.push_back({i, scheduled});
+    }
+    jobs_cv.notify_one();
+  }
+
+  {
+    std::lock_guard lock{jobs_mutex};
+    done_scheduling = true;
+  }
+  jobs_cv.notify_all();
+  for (auto &thread : workers)
+    thread.join();
+
+  const std::chrono::duration<double> elapsed{clock_type::now() - begin_time};
+  discord.stop();
+  std::filesystem::remove_all(scratch);
+
+  // ----- Report -----
+  const auto &all = stats["all"];
+  fmt::print("\n{} frames in {:.2f}s: {:.1f} frames/s, {} REST calls ({:.2f}/frame), {} failed, {} errors\n\n",
+      total, elapsed.count(), total / elapsed.count(), stand_in.rest_calls.load(),
+      static_cast<double>(stand_in.rest_calls.load()) / total, stand_in.rest_errors.load(), all.errors);
+
+  fmt::print("{:<22}{:>8}{:>8}{:>12}{:>12}{:>12}\n", "command", "count", "errors", "p50 (ms)", "p99 (ms)",
+      "p999 (ms)");
+  for (auto &[label, entry] : stats) {
+    std::ranges::sort(entry.milliseconds);
+    fmt::print("{:<22}{:>8}{:>8}{:>12.2f}{:>12.2f}{:>12.2f}\n", label, entry.milliseconds.size(), entry.errors,
+        percentile(entry.milliseconds, 0.50), percentile(entry.milliseconds, 0.99),
+        percentile(entry.milliseconds, 0.999));
+  }
+
+  return all.errors == 0 && stand_in.rest_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+#include "render_load.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+// Enough to average over without the window growing without bound during a flood
+constexpr std::size_t max_finished{64};
+} // namespace
+
+const render_tier *pick_render_tier(const std::vector<render_tier> &tiers, const std::size_t active_jobs,
+    const std::chrono::milliseconds recent_render_time) {
+  const render_tier *result{nullptr};
+  for (const auto &tier : tiers) {
+    const auto busy = tier.active_jobs != 0 && active_jobs >= tier.active_jobs;
+    const auto slow = tier.recent_render_time.count() != 0 && recent_render_time >= tier.recent_render_time;
+    if ((busy || slow) && (result == nullptr || tier.max_width < result->max_width))
+      result = &tier;
+  }
+  return result;
+}
+
+RenderLoad::RenderLoad(std::vector<render_tier> tiers, const std::chrono::milliseconds window)
+    : tiers(std::move(tiers)), window(window) {
+}
+
+void RenderLoad::prune(const clock_type::time_point now) const {
+  while (!finished.empty() && (now - finished.front().first > window || finished.size() > max_finished))
+    finished.pop_front();
+}
+
+RenderLoad::clock_type::duration RenderLoad::recent_locked(const clock_type::time_point now) const {
+  prune(now);
+  if (finished.empty())
+    return {};
+
+  clock_type::duration total{0};
+  for (const auto &[_, duration] : finished)
+    total += duration;
+  return total / static_cast<clock_type::rep>(finished.size());
+}
+
+RenderLoad::job RenderLoad::begin(const std::int64_t requested_width) {
+  const auto now = clock_type::now();
+  std::lock_guard lock{mutex};
+
+  const auto recent = std::chrono::duration_cast<std::chrono::milliseconds>(recent_locked(now));
+  const auto *tier = pick_render_tier(tiers, active, recent);
+  active++;
+
+  if (tier == nullptr || requested_width <= tier->max_width)
+    return {this, now, requested_width, false};
+  return {this, now, std::max<std::int64_t>(tier->max_width, 1), true};
+}
+
+void RenderLoad::finish(const clock_type::time_point started, const bool rendered) {
+  const auto now = clock_type::now();
+  std::lock_guard lock{mutex};
+  active--;
+  if (rendered)
+    finished.emplace_back(now, now - started);
+  prune(now);
+}
+
+std::size_t RenderLoad::active_jobs() const {
+  std::lock_guard lock{mutex};
+  return active;
+}
+
+std::chrono::milliseconds RenderLoad::recent_render_time() const {
+  std::lock_guard lock{mutex};
+  return std::chrono::duration_cast<std::chrono::milliseconds>(recent_locked(clock_type::now()));
+}
+
+RenderLoad::job::job(RenderLoad *load, const clock_type::time_point started, const std::int64_t width,
+    const bool clamped)
+    : load(load), started(started), width(width), clamped(clamped) {
+}
+
+RenderLoad::job::job(job &&other) noexcept
+    : load(std::exchange(other.load, nullptr)), started(other.started), rendered(other.rendered), width(other.width),
+      clamped(other.clamped) {
+}
+
+RenderLoad::job::~job() {
+  if (load != nullptr)
+    load->finish(started, rendered);
+}
+
+void RenderLoad::job::completed() {
+  rendered = true;
+}
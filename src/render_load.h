@@ -0,0 +1,70 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// A step down in quality for when `bone-sus` is busy.
+// A tier applies once either limit is reached, a limit of 0 is never reached
+struct render_tier {
+  // Other sus jobs already in flight, counting ones still waiting on the pool
+  std::size_t active_jobs{0};
+  // Average time from request to finished render over the recent window
+  std::chrono::milliseconds recent_render_time{0};
+  std::int64_t max_width{255};
+};
+
+// Keeps track of how loaded sus rendering is, and how far to cut the width back because of it.
+// Each request holds a `job` for as long as it's in flight
+class RenderLoad {
+  using clock_type = std::chrono::steady_clock;
+
+  std::vector<render_tier> tiers;
+  std::chrono::milliseconds window;
+
+  mutable std::mutex mutex;
+  std::size_t active{0};
+  // Trimmed to the window whenever it's read
+  mutable std::deque<std::pair<clock_type::time_point, clock_type::duration>> finished;
+
+  void prune(clock_type::time_point now) const;
+  [[nodiscard]] clock_type::duration recent_locked(clock_type::time_point now) const;
+  void finish(clock_type::time_point started, bool rendered);
+
+public:
+  class job {
+    RenderLoad *load;
+    clock_type::time_point started;
+    bool rendered{false};
+
+  public:
+    std::int64_t width;
+    // Set when the load cut the width down from what was asked for
+    bool clamped;
+
+    job(RenderLoad *load, clock_type::time_point started, std::int64_t width, bool clamped);
+    job(job &&other) noexcept;
+    job(const job &) = delete;
+    job &operator=(const job &) = delete;
+    job &operator=(job &&) = delete;
+    // Stops counting as active either way, but only a job that rendered counts towards the recent time
+    ~job();
+
+    // Call once the render has actually run, failed downloads and the like shouldn't drag the average down
+    void completed();
+  };
+
+  explicit RenderLoad(std::vector<render_tier> tiers, std::chrono::milliseconds window = std::chrono::minutes{1});
+
+  // Starts tracking a request, and picks the width it should render at
+  [[nodiscard]] job begin(std::int64_t requested_width);
+
+  [[nodiscard]] std::size_t active_jobs() const;
+  [[nodiscard]] std::chrono::milliseconds recent_render_time() const;
+};
+
+// The strictest tier that `active_jobs` or `recent_render_time` reaches, `nullptr` when none do
+const render_tier *pick_render_tier(const std::vector<render_tier> &tiers, std::size_t active_jobs,
+    std::chrono::milliseconds recent_render_time);
@@ -0,0 +1,161 @@
+#include "responder.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <spdlog/spdlog.h>
+#include <stop_token>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct Responder::state : std::enable_shared_from_this<state> {
+  enum class stage { pending, replying, replied, deferring, deferred };
+
+  dpp::slashcommand_t event;
+  DiscordApi &discord;
+  std::mutex mutex;
+  stage current{stage::pending};
+  // Latest response given while the reply or deferral was still in flight
+  std::optional<dpp::message> queued;
+
+  state(const dpp::slashcommand_t &event, DiscordApi &discord) : event(event), discord(discord) {
+  }
+
+  // The callbacks keep the state alive, the handler may well be gone by the time Discord answers
+  dpp::command_completion_event_t on_acknowledged(const std::string_view action) {
+    return [self = shared_from_this(), action](const dpp::confirmation_callback_t &cb) {
+      if (cb.is_error())
+        spdlog::error("Failed to {} interaction: {}", action, cb.get_error().human_readable);
+      self->acknowledged();
+    };
+  }
+
+  static dpp::command_completion_event_t on_edited() {
+    return [](const dpp::confirmation_callback_t &cb) {
+      if (cb.is_error())
+        spdlog::error("Failed to edit interaction response: {}", cb.get_error().human_readable);
+    };
+  }
+
+  void defer() {
+    {
+      std::lock_guard lock{mutex};
+      if (current != stage::pending)
+        return;
+      current = stage::deferring;
+    }
+    discord.interaction_defer(event, on_acknowledged("defer"));
+  }
+
+  void acknowledged() {
+    std::optional<dpp::message> response;
+    {
+      std::lock_guard lock{mutex};
+      current = current == stage::replying ? stage::replied : stage::deferred;
+      response.swap(queued);
+    }
+    if (response)
+      discord.interaction_edit(event, response.value(), on_edited());
+  }
+
+  void respond(const dpp::message &message) {
+    std::unique_lock lock{mutex};
+    switch (current) {
+    case stage::pending:
+      current = stage::replying;
+      lock.unlock();
+      discord.interaction_reply(event, message, on_acknowledged("reply to"));
+      break;
+    case stage::replying:
+      [[fallthrough]];
+    case stage::deferring:
+      // Replies and edits go through different rate-limit buckets, an edit sent now could beat the reply
+      queued = message;
+      break;
+    case stage::replied:
+      [[fallthrough]];
+    case stage::deferred:
+    default:
+      lock.unlock();
+      discord.interaction_edit(event, message, on_edited());
+      break;
+    }
+  }
+};
+
+namespace {
+// One thread for every pending deferral, rather than a timer per command
+class DeferralTimer {
+  using clock_type = std::chrono::steady_clock;
+  using entry = std::pair<clock_type::time_point, std::function<void()>>;
+
+  struct later_first {
+    bool operator()(const entry &a, const entry &b) const {
+      return a.first > b.first;
+    }
+  };
+
+  std::mutex mutex;
+  std::condition_variable_any wake;
+  std::priority_queue<entry, std::vector<entry>, later_first> pending;
+  std::jthread worker{[this](const std::stop_token &stop) { run(stop); }};
+
+  void run(const std::stop_token &stop) {
+    std::unique_lock lock{mutex};
+    while (!stop.stop_requested()) {
+      if (pending.empty()) {
+        wake.wait(lock, stop, [this] { return !pending.empty(); });
+        continue;
+      }
+
+      const auto due = pending.top().first;
+      if (clock_type::now() < due) {
+        wake.wait_until(lock, stop, due, [this, due] { return !pending.empty() && pending.top().first < due; });
+        continue;
+      }
+
+      auto action = pending.top().second;
+      pending.pop();
+      lock.unlock();
+      action();
+      lock.lock();
+    }
+  }
+
+public:
+  void schedule(const clock_type::duration delay, std::function<void()> action) {
+    {
+      std::lock_guard lock{mutex};
+      pending.emplace(clock_type::now() + delay, std::move(action));
+    }
+    wake.notify_one();
+  }
+};
+
+DeferralTimer &deferral_timer() {
+  static DeferralTimer timer;
+  return timer;
+}
+} // namespace
+
+Responder::Responder(const dpp::slashcommand_t &event, DiscordApi &discord, const std::chrono::milliseconds budget)
+    : shared(std::make_shared<state>(event, discord)) {
+  deferral_timer().schedule(budget, [weak = std::weak_ptr{shared}]() {
+    if (const auto locked = weak.lock())
+      locked->defer();
+  });
+}
+
+void Responder::respond(const dpp::message &message) const {
+  shared->respond(message);
+}
+
+void Responder::respond(const std::string &content) const {
+  shared->respond(dpp::message{content});
+}
+
+void Responder::defer() const {
+  shared->defer();
+}
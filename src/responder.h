@@ -0,0 +1,28 @@
+#pragma once
+#include "discord_api.h"
+#include <chrono>
+#include <dpp/dpp.h>
+#include <memory>
+#include <string>
+
+// Answers a slash command in as few round-trips as it can.
+// If the handler responds within `budget` the answer goes out as the interaction
+// reply itself. Only once the budget runs out does it defer ("Bone Bot is thinking...")
+// and later responses edit that. Responses that land while the reply or deferral is
+// still in flight wait for it, so nothing edits a response Discord hasn't seen yet.
+//
+// Copies share the same state, so it's safe to hand one to a callback
+class Responder {
+  struct state;
+  std::shared_ptr<state> shared;
+
+public:
+  Responder(const dpp::slashcommand_t &event, DiscordApi &discord, std::chrono::milliseconds budget);
+
+  // The first call replies (or queues behind the deferral), later calls edit the response
+  void respond(const dpp::message &message) const;
+  void respond(const std::string &content) const;
+
+  // Defer straight away, for handlers that know they'll be slow
+  void defer() const;
+};
@@ -0,0 +1,48 @@
+#include "sampling.h"
+#include <algorithm>
+#include <bit>
+
+std::uint64_t mix64(std::uint64_t value) {
+  value += 0x9E3779B97F4A7C15ULL;
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
+
+FeistelPermutation::FeistelPermutation(const std::uint64_t domain, const std::uint64_t key)
+    : domain(std::max<std::uint64_t>(domain, 1)) {
+  // Bits needed for the largest index, split evenly between the two halves
+  const auto bits = std::max(static_cast<int>(std::bit_width(this->domain - 1)), 2);
+  half_bits = static_cast<unsigned>(bits + 1) / 2;
+  half_mask = (std::uint64_t{1} << half_bits) - 1;
+
+  auto state = key;
+  for (auto &round_key : round_keys) {
+    state = mix64(state);
+    round_key = state;
+  }
+}
+
+std::uint64_t FeistelPermutation::size() const {
+  return domain;
+}
+
+std::uint64_t FeistelPermutation::encrypt(const std::uint64_t value) const {
+  auto left = value >> half_bits;
+  auto right = value & half_mask;
+  for (const auto round_key : round_keys) {
+    const auto next_right = left ^ (mix64(right ^ round_key) & half_mask);
+    left = right;
+    right = next_right;
+  }
+  return (left << half_bits) | right;
+}
+
+std::uint64_t FeistelPermutation::operator()(const std::uint64_t index) const {
+  // The network is a bijection on [0, 2^(2 * half_bits)), so following it from
+  // an index inside the domain always lands back inside the domain
+  auto value = encrypt(index);
+  while (value >= domain)
+    value = encrypt(value);
+  return value;
+}
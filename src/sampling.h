@@ -0,0 +1,28 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Keyed bijection over [0, domain), i.e. a shuffled order of every index that
+// takes O(1) memory. A balanced Feistel network permutes the smallest even
+// power of two covering the domain, and cycle-walking steps back inside it,
+// which takes fewer than 4 passes on average.
+class FeistelPermutation {
+  std::uint64_t domain{1};
+  unsigned half_bits{1};
+  std::uint64_t half_mask{1};
+  std::array<std::uint64_t, 4> round_keys{};
+
+  [[nodiscard]] std::uint64_t encrypt(std::uint64_t value) const;
+
+public:
+  FeistelPermutation() = default;
+  FeistelPermutation(std::uint64_t domain, std::uint64_t key);
+
+  [[nodiscard]] std::uint64_t size() const;
+
+  // `index` must be less than `size()`
+  [[nodiscard]] std::uint64_t operator()(std::uint64_t index) const;
+};
+
+// Cheap, well mixed 64-bit hash (splitmix64's finaliser)
+[[nodiscard]] std::uint64_t mix64(std::uint64_t value);
@@ -0,0 +1,298 @@
+#include "team_history.h"
+#include "sampling.h"
+#include <bit>
+#include <chrono>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+constexpr std::uint64_t index_magic{0x5844'4E49'5249'4150ULL}; // "PAIRINDX"
+constexpr std::uint32_t index_version{1};
+constexpr std::uint32_t record_magic{0x4D41'4554U}; // "TEAM"
+constexpr std::uint64_t initial_capacity{1024};
+} // namespace
+
+struct TeamHistory::index_header {
+  std::uint64_t magic;
+  std::uint32_t version;
+  // Set while counts are being changed, an index left dirty by a crash is rebuilt from the log
+  std::uint32_t dirty;
+  std::uint64_t capacity; // Always a power of 2
+  std::uint64_t size;
+  // How much of the log is already counted in the index
+  std::uint64_t log_bytes;
+};
+
+// Pairs are stored with the lower id first, user ids are never 0 so that marks an empty slot
+struct TeamHistory::pair_slot {
+  std::uint64_t low;
+  std::uint64_t high;
+  std::uint32_t count;
+  std::uint32_t reserved;
+};
+
+TeamHistory::TeamHistory(const std::filesystem::path &directory)
+    : log_path(directory / "team-log.bin"), index_path(directory / "pair-index.bin") {
+  const auto begin_time = std::chrono::steady_clock::now();
+  std::filesystem::create_directories(directory);
+
+  const auto fd = ::open(index_path.c_str(), O_RDWR);
+  std::size_t file_bytes{0};
+  if (fd >= 0) {
+    struct stat info {};
+    ::fstat(fd, &info);
+    file_bytes = static_cast<std::size_t>(info.st_size);
+  }
+
+  // Only trust an existing index if the header and file size agree
+  bool loaded{false};
+  if (fd >= 0 && file_bytes >= sizeof(index_header)) {
+    map_index(index_path, fd, file_bytes);
+    const auto log_bytes = std::filesystem::exists(log_path) ? std::filesystem::file_size(log_path) : 0;
+    loaded = header->magic == index_magic && header->version == index_version &&
+             std::has_single_bit(header->capacity) &&
+             header->dirty == 0 && file_bytes == sizeof(index_header) + header->capacity * sizeof(pair_slot) &&
+             header->log_bytes <= log_bytes;
+  } else if (fd >= 0) {
+    ::close(fd);
+  }
+
+  if (!loaded) {
+    spdlog::info("Team history index '{}' missing or stale, rebuilding from the log", index_path.string());
+    publish_index(create_index(initial_capacity));
+  }
+
+  catch_up();
+  log.open(log_path, std::ios::binary | std::ios::app);
+
+  const auto end_time = std::chrono::steady_clock::now();
+  spdlog::info("Loaded team history ({} pairs) in {}us", header->size,
+      std::chrono::duration_cast<std::chrono::microseconds>(end_time - begin_time).count());
+}
+
+TeamHistory::~TeamHistory() {
+  if (mapping != nullptr)
+    ::munmap(mapping, mapping_bytes);
+  if (index_fd >= 0)
+    ::close(index_fd);
+}
+
+void TeamHistory::map_index(const std::filesystem::path &path, const int fd, const std::size_t bytes) {
+  auto *const new_mapping = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (new_mapping == MAP_FAILED) {
+    ::close(fd);
+    throw std::runtime_error("Failed to map team history index " + path.string());
+  }
+
+  if (mapping != nullptr)
+    ::munmap(mapping, mapping_bytes);
+  if (index_fd >= 0)
+    ::close(index_fd);
+
+  index_fd = fd;
+  mapping = new_mapping;
+  mapping_bytes = bytes;
+  header = static_cast<index_header *>(mapping);
+  slots = reinterpret_cast<pair_slot *>(static_cast<std::byte *>(mapping) + sizeof(index_header));
+}
+
+// Built to the side, and only renamed into place by `publish_index` once it's complete,
+// so a crash never leaves a half written index
+std::filesystem::path TeamHistory::create_index(const std::uint64_t capacity) {
+  auto temp_path = index_path;
+  temp_path += ".tmp";
+
+  const auto fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  const auto bytes = sizeof(index_header) + capacity * sizeof(pair_slot);
+  if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+    if (fd >= 0)
+      ::close(fd);
+    throw std::runtime_error("Failed to create team history index " + temp_path.string());
+  }
+
+  map_index(temp_path, fd, bytes); // ftruncate zero fills, so every slot starts empty
+  *header = {index_magic, index_version, 0, capacity, 0, 0};
+  return temp_path;
+}
+
+void TeamHistory::publish_index(const std::filesystem::path &temp_path) {
+  ::msync(mapping, mapping_bytes, MS_SYNC);
+  std::filesystem::rename(temp_path, index_path);
+}
+
+void TeamHistory::grow() {
+  const auto old_capacity = header->capacity;
+  const auto old_log_bytes = header->log_bytes;
+  const auto old_dirty = header->dirty;
+  std::vector<pair_slot> old_slots{slots, slots + old_capacity};
+
+  const auto temp_path = create_index(old_capacity * 2);
+  header->log_bytes = old_log_bytes;
+  header->dirty = old_dirty;
+  for (const auto &slot : old_slots) {
+    if (slot.low == 0)
+      continue;
+
+    auto index = mix64(slot.low ^ mix64(slot.high)) & (header->capacity - 1);
+    while (slots[index].low != 0)
+      index = (index + 1) & (header->capacity - 1);
+    slots[index] = slot;
+    header->size++;
+  }
+  publish_index(temp_path);
+}
+
+// Replays any log records the index hasn't seen yet.
+// A torn record at the end (crash mid-append) is cut off
+void TeamHistory::catch_up() {
+  std::ifstream file{log_path, std::ios::binary};
+  if (!file)
+    return;
+
+  file.seekg(static_cast<std::streamoff>(header->log_bytes));
+  auto good_bytes = header->log_bytes;
+  // Counts are checked against what's left of the file before anything is allocated for them,
+  // so a damaged record can't ask for more memory than the log could possibly hold
+  const auto log_size = std::filesystem::file_size(log_path);
+  auto bytes_left = [&file, log_size]() { return log_size - static_cast<std::uint64_t>(file.tellg()); };
+
+  while (true) {
+    std::uint32_t magic{0};
+    std::uint32_t team_count{0};
+    std::int64_t timestamp{0};
+    file.read(reinterpret_cast<char *>(&magic), sizeof magic);
+    file.read(reinterpret_cast<char *>(&team_count), sizeof team_count);
+    file.read(reinterpret_cast<char *>(&timestamp), sizeof timestamp);
+    if (!file || magic != record_magic || team_count > bytes_left() / sizeof(std::uint32_t))
+      break;
+
+    std::vector<std::vector<std::uint64_t>> teams(team_count);
+    for (auto &team : teams) {
+      std::uint32_t member_count{0};
+      file.read(reinterpret_cast<char *>(&member_count), sizeof member_count);
+      if (!file || member_count > bytes_left() / sizeof(std::uint64_t)) {
+        file.setstate(std::ios::failbit);
+        break;
+      }
+      team.resize(member_count);
+      file.read(reinterpret_cast<char *>(team.data()),
+          static_cast<std::streamsize>(member_count * sizeof(std::uint64_t)));
+    }
+    if (!file)
+      break;
+
+    good_bytes = static_cast<std::uint64_t>(file.tellg());
+    header->dirty = 1;
+    for (const auto &team : teams)
+      add_team(team);
+    header->log_bytes = good_bytes;
+    header->dirty = 0;
+  }
+
+  file.close();
+  if (log_size != good_bytes) {
+    spdlog::warn("Team history log '{}' has a torn record at the end, truncating", log_path.string());
+    std::filesystem::resize_file(log_path, good_bytes);
+  }
+}
+
+void TeamHistory::add_team(const std::vector<std::uint64_t> &members) {
+  for (std::size_t i = 0; i < members.size(); i++) {
+    for (auto j = i + 1; j < members.size(); j++)
+      add_pair(members[i], members[j]);
+  }
+}
+
+void TeamHistory::add_pair(std::uint64_t a, std::uint64_t b) {
+  if (a == b || a == 0 || b == 0)
+    return;
+  if (a > b)
+    std::swap(a, b);
+
+  // Keep the load factor under 0.7 so probe chains stay short
+  if ((header->size + 1) * 10 > header->capacity * 7)
+    grow();
+
+  auto index = mix64(a ^ mix64(b)) & (header->capacity - 1);
+  while (slots[index].low != 0 && (slots[index].low != a || slots[index].high != b))
+    index = (index + 1) & (header->capacity - 1);
+
+  auto &slot = slots[index];
+  if (slot.low == 0) {
+    slot.low = a;
+    slot.high = b;
+    header->size++;
+  }
+  slot.count++;
+}
+
+std::uint32_t TeamHistory::find_pair(std::uint64_t a, std::uint64_t b) const {
+  if (a > b)
+    std::swap(a, b);
+
+  auto index = mix64(a ^ mix64(b)) & (header->capacity - 1);
+  while (slots[index].low != 0) {
+    if (slots[index].low == a && slots[index].high == b)
+      return slots[index].count;
+    index = (index + 1) & (header->capacity - 1);
+  }
+  return 0;
+}
+
+void TeamHistory::record(const std::vector<std::vector<std::uint64_t>> &teams) {
+  std::string bytes;
+  auto append = [&bytes](const auto &value) {
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof value);
+  };
+
+  append(record_magic);
+  append(static_cast<std::uint32_t>(teams.size()));
+  append(static_cast<std::int64_t>(
+      std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count()));
+  for (const auto &team : teams) {
+    append(static_cast<std::uint32_t>(team.size()));
+    bytes.append(reinterpret_cast<const char *>(team.data()), team.size() * sizeof(std::uint64_t));
+  }
+
+  std::unique_lock lock{mutex};
+  log.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+  log.flush();
+
+  // A crash from here until `dirty` is cleared would leave some of the record counted
+  // but not `log_bytes`, so the next start rebuilds rather than counting it twice
+  header->dirty = 1;
+  for (const auto &team : teams)
+    add_team(team);
+  header->log_bytes += bytes.size();
+  header->dirty = 0;
+}
+
+std::uint32_t TeamHistory::pair_count(const std::uint64_t a, const std::uint64_t b) const {
+  std::shared_lock lock{mutex};
+  return find_pair(a, b);
+}
+
+std::vector<std::uint32_t> TeamHistory::pair_counts(const std::vector<std::uint64_t> &members) const {
+  const auto count = members.size();
+  std::vector<std::uint32_t> result(count * count);
+
+  std::shared_lock lock{mutex};
+  for (std::size_t i = 0; i < count; i++) {
+    for (auto j = i + 1; j < count; j++) {
+      const auto pairs = find_pair(members[i], members[j]);
+      result[i * count + j] = pairs;
+      result[j * count + i] = pairs;
+    }
+  }
+  return result;
+}
+
+std::uint64_t TeamHistory::pair_total() const {
+  std::shared_lock lock{mutex};
+  return header->size;
+}
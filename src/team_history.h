@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <shared_mutex>
+#include <vector>
+
+// Who has been on a team with whom, kept across restarts.
+// Every generated set of teams is appended to a binary log, and pair counts
+// live in an open-addressed hash table that's memory-mapped straight from disk,
+// so startup is a `mmap` plus replaying whatever the log has past the index.
+// If the index is missing or damaged it's rebuilt from the log in one pass.
+class TeamHistory {
+  struct index_header;
+  struct pair_slot;
+
+  std::filesystem::path log_path;
+  std::filesystem::path index_path;
+  std::ofstream log;
+
+  int index_fd{-1};
+  void *mapping{nullptr};
+  std::size_t mapping_bytes{0};
+  index_header *header{nullptr};
+  pair_slot *slots{nullptr};
+
+  mutable std::shared_mutex mutex;
+
+  void map_index(const std::filesystem::path &path, int fd, std::size_t bytes);
+  [[nodiscard]] std::filesystem::path create_index(std::uint64_t capacity);
+  void publish_index(const std::filesystem::path &temp_path);
+  void grow();
+  void catch_up();
+  void add_team(const std::vector<std::uint64_t> &members);
+  void add_pair(std::uint64_t a, std::uint64_t b);
+  [[nodiscard]] std::uint32_t find_pair(std::uint64_t a, std::uint64_t b) const;
+
+public:
+  // Creates `directory` if needed
+  explicit TeamHistory(const std::filesystem::path &directory);
+  ~TeamHistory();
+
+  TeamHistory(const TeamHistory &) = delete;
+  TeamHistory &operator=(const TeamHistory &) = delete;
+
+  // Log a set of teams, each a list of user ids
+  void record(const std::vector<std::vector<std::uint64_t>> &teams);
+
+  // Number of times `a` and `b` have shared a team
+  [[nodiscard]] std::uint32_t pair_count(std::uint64_t a, std::uint64_t b) const;
+
+  // Counts for every pair in `members`, as a row-major `members.size()` square.
+  // Takes the lock once, so it's the one to use when scoring a whole roster
+  [[nodiscard]] std::vector<std::uint32_t> pair_counts(const std::vector<std::uint64_t> &members) const;
+
+  // Distinct pairs that have ever shared a team
+  [[nodiscard]] std::uint64_t pair_total() const;
+};
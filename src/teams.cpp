@@ -1,16 +1,102 @@
 #include "teams.h"
 #include "users.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <random>
 #include <variant>
 #include <ranges>
 #include <fmt/core.h>
+#include <spdlog/spdlog.h>
 #include <dpp/unicode_emoji.h>
 
 std::default_random_engine team_random_engine{std::random_device{}()};
 
+namespace {
+// Hill climbs on member swaps between normal teams until no swap lowers the
+// number of repeat pairings (sum of history counts over everyone sharing a team).
+// Each candidate swap is scored in O(1) from per-member, per-team sums,
+// so even 200 attendees take a few milliseconds. Captains don't move
+void spread_repeat_pairings(std::vector<bone_team> &teams, const TeamHistory &history) {
+  std::vector<std::size_t> normal_teams;
+  std::vector<dpp::guild_member> members;
+  std::vector<std::uint64_t> ids;
+  std::vector<std::size_t> team_of;
+  std::vector<bool> pinned;
+
+  for (std::size_t t = 0; t < teams.size(); t++) {
+    if (teams[t].type != team_type::normal)
+      continue;
+
+    for (const auto &member : teams[t].members) {
+      members.push_back(member);
+      ids.push_back(member.user_id);
+      team_of.push_back(normal_teams.size());
+      pinned.push_back(teams[t].captain && teams[t].captain->user_id == member.user_id);
+    }
+    normal_teams.push_back(t);
+  }
+
+  const auto count = ids.size();
+  const auto team_count = normal_teams.size();
+  if (count < 2 || team_count < 2)
+    return;
+
+  const auto pairs = history.pair_counts(ids);
+  if (std::ranges::all_of(pairs, [](const auto pair_count) { return pair_count == 0; }))
+    return; // Nobody has played together yet
+
+  // sums[m * team_count + t]: how often `m` has played with the people now on team `t`
+  std::vector<std::int64_t> sums(count * team_count);
+  for (std::size_t m = 0; m < count; m++) {
+    for (std::size_t z = 0; z < count; z++)
+      sums[m * team_count + team_of[z]] += pairs[m * count + z];
+  }
+
+  // Well past what 200 attendees need, only here so a pathological roster can't hold up the reply
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{8};
+  for (auto improved = true; improved && std::chrono::steady_clock::now() < deadline;) {
+    improved = false;
+
+    for (std::size_t x = 0; x < count; x++) {
+      if (pinned[x])
+        continue;
+
+      for (auto y = x + 1; y < count; y++) {
+        const auto a = team_of[x];
+        const auto b = team_of[y];
+        if (pinned[y] || a == b)
+          continue;
+
+        const auto together = static_cast<std::int64_t>(pairs[x * count + y]);
+        const auto delta = (sums[x * team_count + b] - together - sums[x * team_count + a]) +
+                           (sums[y * team_count + a] - together - sums[y * team_count + b]);
+        if (delta >= 0)
+          continue;
+
+        team_of[x] = b;
+        team_of[y] = a;
+        for (std::size_t m = 0; m < count; m++) {
+          const auto with_x = static_cast<std::int64_t>(pairs[m * count + x]);
+          const auto with_y = static_cast<std::int64_t>(pairs[m * count + y]);
+          sums[m * team_count + a] += with_y - with_x;
+          sums[m * team_count + b] += with_x - with_y;
+        }
+        improved = true;
+      }
+    }
+  }
+
+  // Members keep their original order, so captains stay at the top of their team
+  for (const auto t : normal_teams)
+    teams[t].members.clear();
+  for (std::size_t m = 0; m < count; m++)
+    teams[normal_teams[team_of[m]]].members.push_back(members[m]);
+}
+} // namespace
+
 std::vector<bone_team> make_teams(const std::vector<dpp::guild_member> &members, std::optional<int> team_count,
-    std::optional<int> team_size, std::vector<dpp::guild_member> captains) {
+    std::optional<int> team_size, std::vector<dpp::guild_member> captains, const TeamHistory *history) {
 
   int generate_teams{2}; // generate 2 teams by default
   if (team_count)
@@ -66,10 +152,28 @@ std::vector<bone_team> make_teams(const std::vector<dpp::guild_member> &members,
     result[team_index].members.emplace_back(member);
   }
 
+  if (history)
+    spread_repeat_pairings(result, *history);
+
   return result;
 }
 
-std::string format_teams(const std::vector<bone_team> &teams, const word_collection &words) {
+void record_teams(const std::vector<bone_team> &teams, TeamHistory &history) {
+  std::vector<std::vector<std::uint64_t>> played;
+  for (const auto &team : teams) {
+    if (team.type != team_type::normal)
+      continue;
+
+    auto &ids = played.emplace_back();
+    ids.reserve(team.members.size());
+    for (const auto &member : team.members)
+      ids.push_back(member.user_id);
+  }
+
+  history.record(played);
+}
+
+std::string format_teams(const std::vector<bone_team> &teams, const std::function<std::string()> &next_team_name) {
   std::stringstream ss;
 
   for (auto index = 0; const auto &team : teams) {
@@ -77,10 +181,10 @@ std::string format_teams(const std::vector<bone_team> &teams, const word_collect
     default:
       [[fallthrough]];
     case team_type::normal:
-      ss << "Team " << index << " '" << team_name(words) << "' :\n";
+      ss << "Team " << index << " '" << next_team_name() << "' :\n";
       break;
     case team_type::extra:
-      ss << "Extras '" << team_name(words) << "'\n";
+      ss << "Extras '" << next_team_name() << "'\n";
       break;
     }
 
@@ -96,7 +200,8 @@ std::string format_teams(const std::vector<bone_team> &teams, const word_collect
   return ss.str();
 }
 
-dpp::task<std::vector<dpp::guild_member>> get_captains_for_command(const dpp::slashcommand_t &event) {
+dpp::task<std::vector<dpp::guild_member>> get_captains_for_command(
+    const dpp::slashcommand_t &event, DiscordApi &discord) {
   std::vector<dpp::guild_member> captains{};
   captains.reserve(4);
 
@@ -105,7 +210,7 @@ dpp::task<std::vector<dpp::guild_member>> get_captains_for_command(const dpp::sl
     if (!std::holds_alternative<dpp::snowflake>(captain_param))
       continue;
 
-    const auto maybe_captain = co_await get_user(std::get<dpp::snowflake>(captain_param), event);
+    const auto maybe_captain = co_await get_user(std::get<dpp::snowflake>(captain_param), event, discord);
     if (!maybe_captain)
       continue;
 
@@ -114,3 +219,96 @@ dpp::task<std::vector<dpp::guild_member>> get_captains_for_command(const dpp::sl
 
   co_return captains;
 }
+
+std::vector<std::optional<dpp::snowflake>> get_voice_targets_for_command(const dpp::slashcommand_t &event) {
+  std::vector<std::optional<dpp::snowflake>> targets(4);
+  auto any_target{false};
+
+  for (auto i = 1; i <= 4; i++) {
+    const auto &voice_param = event.get_parameter(fmt::format("voice-{}", i));
+    if (!std::holds_alternative<dpp::snowflake>(voice_param))
+      continue;
+
+    targets[i - 1] = std::get<dpp::snowflake>(voice_param);
+    any_target = true;
+  }
+
+  if (!any_target)
+    targets.clear();
+  return targets;
+}
+
+bool can_move_members(const dpp::slashcommand_t &event, const dpp::snowflake source_channel,
+    const std::vector<std::optional<dpp::snowflake>> &targets) {
+  const auto guild = dpp::find_guild(event.command.guild_id);
+  if (guild == nullptr)
+    return false;
+
+  auto can_move_in = [&guild, &event](const dpp::snowflake channel_id) {
+    const auto channel = dpp::find_channel(channel_id);
+    return channel != nullptr &&
+           guild->permission_overwrites(event.command.member, *channel).can(dpp::p_move_members);
+  };
+
+  if (!can_move_in(source_channel))
+    return false;
+  return std::ranges::all_of(targets, [&can_move_in](const std::optional<dpp::snowflake> &target) {
+    return !target || can_move_in(target.value());
+  });
+}
+
+dpp::task<void> move_teams_to_channels(const dpp::slashcommand_t &event, DiscordApi &discord,
+    const Responder &responder, const std::vector<bone_team> &teams,
+    const std::vector<std::optional<dpp::snowflake>> &targets, const dpp::snowflake source_channel,
+    const std::string &teams_message) {
+  struct pending_move {
+    dpp::snowflake user_id;
+    dpp::async<dpp::confirmation_callback_t> request;
+  };
+  std::vector<pending_move> moves;
+
+  // `dpp::async` sends its request as soon as it's made, so this puts every move in flight at once
+  for (std::size_t i = 0; i < teams.size() && i < targets.size(); i++) {
+    if (teams[i].type != team_type::normal || !targets[i] || targets[i].value() == source_channel)
+      continue;
+
+    for (const auto &member : teams[i].members) {
+      moves.push_back(
+          {member.user_id, discord.co_guild_member_move(targets[i].value(), event.command.guild_id, member.user_id)});
+    }
+  }
+
+  if (moves.empty())
+    co_return;
+
+  spdlog::info("Moving {} members out of channel {}", moves.size(), source_channel.str());
+  const auto begin_time = std::chrono::steady_clock::now();
+
+  // Edit at most every quarter of the way, the edits share a rate limit of their own
+  const auto progress_step = std::max<std::size_t>(moves.size() / 4, 1);
+  std::vector<dpp::snowflake> failed;
+  for (std::size_t done = 0; auto &move : moves) {
+    const auto result = co_await move.request;
+    if (result.is_error()) {
+      spdlog::error("Failed to move {}: {}", move.user_id.str(), result.get_error().human_readable);
+      failed.push_back(move.user_id);
+    }
+
+    done++;
+    if (done % progress_step == 0 && done != moves.size())
+      responder.respond(fmt::format("{}\nMoving players... {}/{}", teams_message, done, moves.size()));
+  }
+
+  spdlog::info("Moved {} members in {}ms", moves.size() - failed.size(),
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin_time).count());
+
+  std::string summary{fmt::format("{}\nMoved {}/{} players", teams_message, moves.size() - failed.size(),
+      moves.size())};
+  if (!failed.empty()) {
+    summary += ", couldn't move:";
+    for (const auto user_id : failed)
+      summary += fmt::format(" <@{}>", user_id.str());
+  }
+
+  responder.respond(summary);
+}
@@ -1,7 +1,10 @@
 #pragma once
-#include "insults.h"
+#include "discord_api.h"
+#include "responder.h"
+#include "team_history.h"
 #include "users.h"
 #include <dpp/dpp.h>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -15,9 +18,33 @@ struct bone_team {
   std::vector<dpp::guild_member> members;
 };
 
+// When `history` is given, members are swapped between the (non-extra) teams
+// to keep people who have often played together apart
 std::vector<bone_team> make_teams(const std::vector<dpp::guild_member> &members, std::optional<int> team_count = {},
-    std::optional<int> team_size = {}, std::vector<dpp::guild_member> captains = {});
+    std::optional<int> team_size = {}, std::vector<dpp::guild_member> captains = {},
+    const TeamHistory *history = nullptr);
 
-std::string format_teams(const std::vector<bone_team> &teams, const word_collection &words);
+// Log the non-extra teams so later `make_teams` calls can spread them out
+void record_teams(const std::vector<bone_team> &teams, TeamHistory &history);
 
-dpp::task<std::vector<dpp::guild_member>> get_captains_for_command(const dpp::slashcommand_t &event);
+// Each team is named by `next_team_name`
+std::string format_teams(const std::vector<bone_team> &teams, const std::function<std::string()> &next_team_name);
+
+dpp::task<std::vector<dpp::guild_member>> get_captains_for_command(
+    const dpp::slashcommand_t &event, DiscordApi &discord);
+
+// Positional voice channels (`voice-1` to `voice-4`) to move each team into, empty if none were given
+std::vector<std::optional<dpp::snowflake>> get_voice_targets_for_command(const dpp::slashcommand_t &event);
+
+// Whether the member who ran the command has 'Move Members' in `source_channel` and every target,
+// counting channel overwrites rather than just their guild-wide permissions
+bool can_move_members(const dpp::slashcommand_t &event, dpp::snowflake source_channel,
+    const std::vector<std::optional<dpp::snowflake>> &targets);
+
+// Moves every member of team N into `targets[N]`, skipping anyone already there.
+// All the moves are queued at once and DPP's REST queue spreads them out per rate-limit bucket,
+// while the response is edited with progress under `teams_message`
+dpp::task<void> move_teams_to_channels(const dpp::slashcommand_t &event, DiscordApi &discord,
+    const Responder &responder, const std::vector<bone_team> &teams,
+    const std::vector<std::optional<dpp::snowflake>> &targets, dpp::snowflake source_channel,
+    const std::string &teams_message);
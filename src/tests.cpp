@@ -1,8 +1,26 @@
+#include "bounded_pool.h"
+#include "commands.h"
+#include "discord_api.h"
+#include "render_load.h"
+#include "responder.h"
+#include "sampling.h"
+#include "team_history.h"
 #include "teams.h"
+#include <array>
+#include <chrono>
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <dpp/json.h>
+#include <filesystem>
 #include <fmt/format.h>
+#include <fstream>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <iostream>
 
 std::vector<dpp::guild_member> fake_members(int count) {
@@ -108,3 +126,428 @@ TEST_CASE("Team captains are respected", "[teams]") {
   REQUIRE(std::ranges::find_if(team_2, find_captain_2) != team_2.end());
   REQUIRE(std::ranges::find_if(team_2, find_captain_1) == team_2.end());
 };
+
+TEST_CASE("Word files take optional weights", "[insults]") {
+  const auto path = std::filesystem::temp_directory_path() / "bone-bot-weighted-words.txt";
+  {
+    std::ofstream file{path};
+    file << "bilge rat\t3\nscallywag\nlandlubber\t0\nswab\tlots\r\nbarnacle\tnan\nbosun\tinf\n";
+  }
+
+  word_list words;
+  read_in_words(path, words);
+  std::filesystem::remove(path);
+
+  // 0 weights are dropped, bad or non-finite weights fall back to 1
+  REQUIRE(words.words == std::vector<std::string>{"bilge rat", "scallywag", "swab", "barnacle", "bosun"});
+}
+
+TEST_CASE("Feistel permutations visit every index once", "[sampling]") {
+  for (std::uint64_t domain = 1; domain < 600; domain += 7) {
+    const FeistelPermutation permutation{domain, domain * 31};
+    std::vector<bool> seen(domain);
+
+    for (std::uint64_t i = 0; i < domain; i++) {
+      const auto value = permutation(i);
+      REQUIRE(value < domain);
+      REQUIRE_FALSE(seen[value]);
+      seen[value] = true;
+    }
+  }
+}
+
+word_list even_words(const std::vector<std::string> &words) {
+  return {words};
+}
+
+TEST_CASE("Team names don't repeat within a channel", "[insults]") {
+  const word_collection words{even_words({"parrot", "plank"}), even_words({"swabs", "rats", "dogs", "mates"}),
+      even_words({"salty", "scurvy", "lily-livered"}), even_words({"plundering"})};
+  InsultStreams insults{words};
+
+  // 3 adjectives x 4 plural nouns
+  std::set<std::string> channel_1;
+  std::set<std::string> channel_2;
+  for (auto i = 0; i < 12; i++) {
+    channel_1.insert(insults.team_name(1));
+    channel_2.insert(insults.team_name(2));
+  }
+  REQUIRE(channel_1.size() == 12ul);
+  REQUIRE(channel_2.size() == 12ul);
+
+  // Once they've all been used, another pass starts
+  REQUIRE(channel_1.contains(insults.team_name(1)));
+}
+
+TEST_CASE("Weighted lists don't repeat team names", "[insults]") {
+  const auto path = std::filesystem::temp_directory_path() / "bone-bot-weighted-adjectives.txt";
+  {
+    std::ofstream file{path};
+    file << "salty\t3\nscurvy\n";
+  }
+  word_collection words{even_words({"parrot"}), even_words({"swabs", "rats", "dogs", "mates", "lubbers", "squids"}),
+      {}, even_words({"plundering"})};
+  read_in_words(path, words.adjectives);
+  std::filesystem::remove(path);
+  InsultStreams insults{words};
+
+  // 2 adjectives x 6 nouns, weights don't make any of them come up twice
+  std::set<std::string> names;
+  for (auto i = 0; i < 12; i++)
+    names.insert(insults.team_name(1));
+  REQUIRE(names.size() == 12ul);
+}
+
+// Fresh, empty directory for a `TeamHistory`
+std::filesystem::path history_directory(const std::string &name) {
+  const auto path = std::filesystem::temp_directory_path() / fmt::format("bone-bot-{}-{}", name,
+      std::chrono::steady_clock::now().time_since_epoch().count());
+  std::filesystem::remove_all(path);
+  return path;
+}
+
+TEST_CASE("Team history persists pair counts", "[teams]") {
+  const auto directory = history_directory("history");
+
+  // Big enough to make the index grow a few times
+  std::vector<std::uint64_t> big_team(100);
+  for (std::size_t i = 0; i < big_team.size(); i++)
+    big_team[i] = 1000 + i;
+
+  {
+    TeamHistory history{directory};
+    history.record({{1, 2, 3}, {4, 5}});
+    history.record({{1, 2}, {3, 4}});
+    history.record({big_team});
+
+    REQUIRE(history.pair_count(1, 2) == 2);
+    REQUIRE(history.pair_count(2, 1) == 2);
+    REQUIRE(history.pair_count(3, 4) == 1);
+    REQUIRE(history.pair_count(1, 4) == 0);
+    REQUIRE(history.pair_total() == 5 + 4950);
+  }
+
+  {
+    // Reloaded from the mapped index
+    TeamHistory history{directory};
+    REQUIRE(history.pair_count(1, 2) == 2);
+    REQUIRE(history.pair_count(1000, 1099) == 1);
+    REQUIRE(history.pair_total() == 5 + 4950);
+  }
+
+  std::filesystem::remove(directory / "pair-index.bin");
+  {
+    // Rebuilt from the log
+    TeamHistory history{directory};
+    REQUIRE(history.pair_count(1, 2) == 2);
+    REQUIRE(history.pair_count(4, 5) == 1);
+    REQUIRE(history.pair_total() == 5 + 4950);
+  }
+
+  {
+    // Crashed partway through counting a record: `dirty` is the u32 after the magic and version
+    std::fstream index{directory / "pair-index.bin", std::ios::in | std::ios::out | std::ios::binary};
+    const std::uint32_t dirty{1};
+    index.seekp(12);
+    index.write(reinterpret_cast<const char *>(&dirty), sizeof dirty);
+  }
+  {
+    TeamHistory history{directory};
+    REQUIRE(history.pair_count(1, 2) == 2);
+    REQUIRE(history.pair_total() == 5 + 4950);
+  }
+
+  // Damaged records whose magic still matches, asking for absurd team and member counts
+  const auto log_path = directory / "team-log.bin";
+  const auto good_size = std::filesystem::file_size(log_path);
+  for (const auto &[team_count, member_count] : {std::pair{0xFFFF'FFFFu, 0u}, std::pair{1u, 0xFFFF'FFFFu}}) {
+    {
+      std::ofstream log{log_path, std::ios::binary | std::ios::app};
+      const std::uint32_t magic{0x4D41'4554U};
+      const std::int64_t timestamp{0};
+      log.write(reinterpret_cast<const char *>(&magic), sizeof magic);
+      log.write(reinterpret_cast<const char *>(&team_count), sizeof team_count);
+      log.write(reinterpret_cast<const char *>(&timestamp), sizeof timestamp);
+      log.write(reinterpret_cast<const char *>(&member_count), sizeof member_count);
+    }
+    // Treated as a torn tail, so it's cut off rather than allocated
+    TeamHistory history{directory};
+    REQUIRE(history.pair_total() == 5 + 4950);
+    REQUIRE(std::filesystem::file_size(log_path) == good_size);
+  }
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Diverse teams split up regular teammates", "[teams]") {
+  const auto directory = history_directory("diverse");
+  TeamHistory history{directory};
+
+  // `TeamHistory` treats user 0 as empty
+  auto members = fake_members(9);
+  members.erase(members.begin());
+
+  // Users 1-4 and 5-8 always play together
+  for (auto i = 0; i < 5; i++)
+    history.record({{1, 2, 3, 4}, {5, 6, 7, 8}});
+
+  const auto teams = make_teams(members, 2, {}, {}, &history);
+  REQUIRE(teams.size() == 2ul);
+
+  // The fewest repeats is two from each old team on each new team
+  for (const auto &team : teams) {
+    REQUIRE(team.members.size() == 4ul);
+    const auto old_team_1 = std::ranges::count_if(team.members, [](const dpp::guild_member &member) {
+      return member.user_id <= 4;
+    });
+    REQUIRE(old_team_1 == 2);
+  }
+
+  std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Every command is found by name", "[commands]") {
+  for (const auto &command : command_registry())
+    REQUIRE(find_command(command.name) == &command);
+
+  REQUIRE(find_command("bone-") == nullptr);
+  REQUIRE(find_command("bone-teamz") == nullptr);
+  REQUIRE(find_command("") == nullptr);
+}
+
+TEST_CASE("Command options are unique and within Discord's limits", "[commands]") {
+  // Discord allows 25 options per level
+  auto check_options = [](auto &self, std::span<const option_spec> options) -> void {
+    REQUIRE(options.size() <= 25ul);
+    std::set<std::string_view> names;
+    for (const auto &option : options) {
+      REQUIRE(names.insert(option.name).second);
+      self(self, option.options);
+    }
+  };
+
+  for (const auto &command : command_registry())
+    check_options(check_options, command.options);
+}
+
+// Records the interaction responses instead of sending them, Discord only answers when `acknowledge` is called
+class RecordingApi : public DiscordApi {
+  std::mutex mutex;
+  std::vector<std::string> calls;
+  std::vector<dpp::command_completion_event_t> callbacks;
+
+  void record(const std::string &call, dpp::command_completion_event_t callback) {
+    std::lock_guard lock{mutex};
+    calls.push_back(call);
+    callbacks.push_back(std::move(callback));
+  }
+
+public:
+  void interaction_reply(const dpp::slashcommand_t &, const dpp::message &message,
+      dpp::command_completion_event_t callback) override {
+    record("reply " + message.content, std::move(callback));
+  }
+  void interaction_defer(const dpp::slashcommand_t &, dpp::command_completion_event_t callback) override {
+    record("defer", std::move(callback));
+  }
+  void interaction_edit(const dpp::slashcommand_t &, const dpp::message &message,
+      dpp::command_completion_event_t callback) override {
+    record("edit " + message.content, std::move(callback));
+  }
+
+  void channel_get(dpp::snowflake, dpp::command_completion_event_t) override {
+  }
+  void guild_get_member(dpp::snowflake, dpp::snowflake, dpp::command_completion_event_t) override {
+  }
+  void guild_member_move(dpp::snowflake, dpp::snowflake, dpp::snowflake, dpp::command_completion_event_t) override {
+  }
+  void guild_event_get(dpp::snowflake, dpp::snowflake, dpp::command_completion_event_t) override {
+  }
+  void guild_event_users_get(dpp::snowflake, dpp::snowflake, dpp::command_completion_event_t) override {
+  }
+  void message_get(dpp::snowflake, dpp::snowflake, dpp::command_completion_event_t) override {
+  }
+  void message_create(const dpp::message &, dpp::command_completion_event_t) override {
+  }
+  void download(const std::string &, dpp::http_completion_event) override {
+  }
+
+  std::vector<std::string> sent() {
+    std::lock_guard lock{mutex};
+    return calls;
+  }
+
+  void acknowledge(const std::size_t call) {
+    dpp::command_completion_event_t callback;
+    {
+      std::lock_guard lock{mutex};
+      callback = callbacks.at(call);
+    }
+    if (callback)
+      callback(dpp::confirmation_callback_t{});
+  }
+};
+
+TEST_CASE("Responses wait for the reply to be acknowledged", "[responder]") {
+  using namespace std::chrono_literals;
+  RecordingApi api;
+  const dpp::slashcommand_t event{nullptr, "{}"};
+  const Responder responder{event, api, 1h};
+
+  // pending -> replying
+  responder.respond("first");
+  REQUIRE(api.sent() == std::vector<std::string>{"reply first"});
+
+  // Only the latest response waits for the reply, it's what the edit would end up showing anyway
+  responder.respond("second");
+  responder.respond("third");
+  REQUIRE(api.sent().size() == 1ul);
+
+  // replying -> replied, and the queued response goes out as an edit
+  api.acknowledge(0);
+  REQUIRE(api.sent() == std::vector<std::string>{"reply first", "edit third"});
+
+  responder.respond("fourth");
+  responder.defer(); // Too late, it's already been answered
+  REQUIRE(api.sent() == std::vector<std::string>{"reply first", "edit third", "edit fourth"});
+}
+
+TEST_CASE("Slow commands are deferred, then edited", "[responder]") {
+  using namespace std::chrono_literals;
+  RecordingApi api;
+  const dpp::slashcommand_t event{nullptr, "{}"};
+  const Responder responder{event, api, 10ms};
+
+  // pending -> deferring once the budget runs out
+  for (auto waited = 0ms; api.sent().empty() && waited < 5s; waited += 5ms)
+    std::this_thread::sleep_for(5ms);
+  REQUIRE(api.sent() == std::vector<std::string>{"defer"});
+
+  responder.respond("late");
+  REQUIRE(api.sent().size() == 1ul);
+
+  // deferring -> deferred
+  api.acknowledge(0);
+  REQUIRE(api.sent() == std::vector<std::string>{"defer", "edit late"});
+
+  responder.respond("later");
+  REQUIRE(api.sent() == std::vector<std::string>{"defer", "edit late", "edit later"});
+
+  // Nothing responded before a deferral is acknowledged means nothing to edit in
+  RecordingApi quiet_api;
+  const Responder quiet{event, quiet_api, 1h};
+  quiet.defer();
+  quiet_api.acknowledge(0);
+  REQUIRE(quiet_api.sent() == std::vector<std::string>{"defer"});
+}
+
+TEST_CASE("Heavy commands are turned away while too many are in flight", "[commands]") {
+  using namespace std::chrono_literals;
+  BoundedPool pool{1, 1};
+  {
+    const auto first = pool.try_admit();
+    const auto second = pool.try_admit();
+    REQUIRE(static_cast<bool>(first));
+    REQUIRE(static_cast<bool>(second));
+    REQUIRE(pool.in_flight_jobs() == 2ul);
+
+    const auto turned_away = pool.try_admit();
+    REQUIRE_FALSE(static_cast<bool>(turned_away));
+    REQUIRE(pool.in_flight_jobs() == 2ul);
+
+    // `run_command` answers a turned away `bone-sus` straight away, without downloading anything
+    const auto directory = std::filesystem::temp_directory_path() / "bone-bot-heavy-test";
+    std::filesystem::remove_all(directory);
+    {
+      RecordingApi api;
+      InsultStreams insults{word_collection{}};
+      TeamHistory history{directory};
+      RenderLoad sus_load{{}};
+      bot_context context{api, insults, history, pool, sus_load, 1h, "rusty-sussy", directory, directory};
+
+      auto interaction = dpp::json::parse(R"({"id":"1","application_id":"3","type":2,"token":"token","version":1,)"
+                                          R"("guild_id":"1","channel_id":"2","data":{"id":"3","name":"bone-sus",)"
+                                          R"("type":1,"options":[],"resolved":{}}})");
+      dpp::slashcommand_t event{nullptr, interaction.dump()};
+      event.command.fill_from_json(&interaction);
+
+      const auto command = run_command(event, context);
+      REQUIRE(api.sent() == std::vector<std::string>{"reply Too many of those going right now, try again in a bit"});
+      REQUIRE(pool.in_flight_jobs() == 2ul);
+    }
+    std::filesystem::remove_all(directory);
+  }
+
+  // Finishing lets the next one in
+  REQUIRE(pool.in_flight_jobs() == 0ul);
+  REQUIRE(static_cast<bool>(pool.try_admit()));
+}
+
+TEST_CASE("Sus width is clamped under load", "[sus]") {
+  using namespace std::chrono_literals;
+  const std::vector<render_tier> tiers{{2, 0ms, 64}, {3, 20ms, 21}};
+
+  REQUIRE(pick_render_tier(tiers, 1, 0ms) == nullptr);
+  REQUIRE(pick_render_tier(tiers, 2, 0ms)->max_width == 64);
+  REQUIRE(pick_render_tier(tiers, 5, 0ms)->max_width == 21);
+  REQUIRE(pick_render_tier(tiers, 0, 30ms)->max_width == 21);
+
+  RenderLoad load{tiers};
+  {
+    const auto first = load.begin(200);
+    const auto second = load.begin(200);
+    REQUIRE_FALSE(first.clamped);
+    REQUIRE_FALSE(second.clamped);
+    REQUIRE(load.active_jobs() == 2ul);
+
+    // Two already in flight
+    const auto third = load.begin(200);
+    REQUIRE(third.clamped);
+    REQUIRE(third.width == 64);
+
+    // Narrow enough already, nothing to cut
+    const auto fourth = load.begin(10);
+    REQUIRE_FALSE(fourth.clamped);
+    REQUIRE(fourth.width == 10);
+  }
+  REQUIRE(load.active_jobs() == 0ul);
+
+  // Slow renders push it down a tier even with nothing else going on
+  RenderLoad slow_load{tiers};
+  {
+    auto slow = slow_load.begin(200);
+    std::this_thread::sleep_for(30ms);
+    slow.completed();
+  }
+  // Jobs that never rendered (failed downloads) don't pull the average back down
+  for (auto i = 0; i < 10; i++)
+    const auto failed = slow_load.begin(200);
+  REQUIRE(slow_load.active_jobs() == 0ul);
+  REQUIRE(slow_load.recent_render_time() >= 20ms);
+  const auto after_slow = slow_load.begin(200);
+  REQUIRE(after_slow.width == 21);
+}
+
+TEST_CASE("Diverse teams for 200 attendees", "[.][benchmark]") {
+  const auto directory = history_directory("diverse-bench");
+  TeamHistory history{directory};
+
+  auto members = fake_members(201);
+  members.erase(members.begin());
+
+  // A season of weekly games to spread out
+  for (auto week = 0; week < 52; week++) {
+    const auto teams = make_teams(members, 8);
+    record_teams(teams, history);
+  }
+
+  BENCHMARK("make_teams") {
+    return make_teams(members, 8);
+  };
+
+  BENCHMARK("make_teams, diverse") {
+    return make_teams(members, 8, {}, {}, &history);
+  };
+
+  std::filesystem::remove_all(directory);
+}
@@ -19,11 +19,12 @@ std::optional<dpp::guild_member> get_cached_user(dpp::snowflake user_id, const d
   return {};
 }
 
-dpp::task<std::optional<dpp::guild_member>> get_user(const dpp::snowflake user_id, const dpp::slashcommand_t &event) {
+dpp::task<std::optional<dpp::guild_member>> get_user(
+    const dpp::snowflake user_id, const dpp::slashcommand_t &event, DiscordApi &discord) {
   if (const auto cached_user = get_cached_user(user_id, event.command))
     co_return cached_user;
 
-  const auto confirmation = co_await event.from->creator->co_guild_get_member(event.command.guild_id, user_id);
+  const auto confirmation = co_await discord.co_guild_get_member(event.command.guild_id, user_id);
   if (confirmation.is_error()) {
     spdlog::error(confirmation.get_error().human_readable);
     co_return {};